@@ -12,6 +12,9 @@ SOURCES += main.cpp \
     cwormhole.cpp \
     cobj2ogl.cpp \
     cdsettings.cpp \
+    cmeshcache.cpp \
+    csectorcursor.cpp \
+    csectortree.cpp
 
 HEADERS += cmainwindow.h \
     cglwidget.h \
@@ -20,7 +23,15 @@ HEADERS += cmainwindow.h \
     cwormhole.h \
     cobj2ogl.h \
     cdsettings.h \
+    cmeshcache.h \
+    csectorcursor.h \
+    csectortree.h \
     myinclude.h \
-    vec3.h
+    vec3.h \
+    quat.h \
+    mat4.h
 FORMS += settings.ui
+
+# qmake CONFIG+=stats prints statistics of loaded meshes
+stats:DEFINES += WH_STATS
 RC_FILE = wormhole.rc
@@ -0,0 +1,19 @@
+# -------------------------------------------------
+# Shared part of the wormhole kernel benchmarks
+# -------------------------------------------------
+QT += opengl
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+INCLUDEPATH += ..
+SOURCES += wormholebench.cpp \
+    ../cwormhole.cpp \
+    ../cglobject.cpp \
+    ../cobj2ogl.cpp \
+    ../csectortree.cpp
+HEADERS += ../cwormhole.h \
+    ../cglobject.h \
+    ../cobj2ogl.h \
+    ../csectortree.h \
+    ../myinclude.h \
+    ../vec3.h
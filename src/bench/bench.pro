@@ -0,0 +1,8 @@
+# -------------------------------------------------
+# Benchmarks of cWormhole ring and normal kernels, both with SSE and with
+# WH_NO_SIMD. Build with qmake bench.pro && make, then run both binaries.
+# -------------------------------------------------
+TEMPLATE = subdirs
+SUBDIRS = sse scalar
+sse.file = bench_sse.pro
+scalar.file = bench_scalar.pro
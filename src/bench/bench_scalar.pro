@@ -0,0 +1,7 @@
+# -------------------------------------------------
+# Wormhole kernels with the scalar fallback
+# -------------------------------------------------
+include(bench.pri)
+TARGET = wormholebench_scalar
+OBJECTS_DIR = obj_scalar
+DEFINES += WH_NO_SIMD
@@ -0,0 +1,6 @@
+# -------------------------------------------------
+# Wormhole kernels with SSE
+# -------------------------------------------------
+include(bench.pri)
+TARGET = wormholebench_sse
+OBJECTS_DIR = obj_sse
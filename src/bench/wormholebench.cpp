@@ -0,0 +1,303 @@
+/*!
+ * \file wormholebench.cpp
+ *
+ * \author David Smejkal
+ * \date 17.10.2026
+ *
+ * Benchmark of cWormhole ring and normal generation. Built twice by
+ * bench.pro, with SSE and with WH_NO_SIMD, so both paths can be compared.
+ * Each build also times the per vertex generators cWormhole had before its
+ * kernels were vectorised, as the baseline.
+ */
+
+#include <QtGui/QApplication>
+#include <QTime>
+#include <QVector>
+
+#include <cstdio>
+#include <cmath>
+
+#include "cwormhole.h"
+
+// largest wormhole the sliders allow
+static const int benchWhSectors = 400;
+static const int benchCircleSectors = 200;
+static const int benchRuns = 200;
+// kernel time is the best of this many batches of benchRuns runs
+static const int benchBatches = 5;
+
+/*!
+ * \brief Unit normal of face, (1, 0, 0) for a degenerate one.
+ *
+ * Baseline, the former cWormhole::computeFaceNormal().
+ */
+static sPoint3 baselineFaceNormal(const sPoint3 &point0,
+                                  const sPoint3 &point1,
+                                  const sPoint3 &point2)
+{
+    sPoint3 n;
+    float dx1 = point1.x - point0.x;
+    float dy1 = point1.y - point0.y;
+    float dz1 = point1.z - point0.z;
+    float dx2 = point2.x - point0.x;
+    float dy2 = point2.y - point0.y;
+    float dz2 = point2.z - point0.z;
+    n.x = dy1*dz2 - dz1*dy2;
+    n.y = dz1*dx2 - dx1*dz2;
+    n.z = dx1*dy2 - dy1*dx2;
+    float d = sqrt(n.x*n.x + n.y*n.y + n.z*n.z);
+    if(d == 0.0)
+    {
+        n.x = 1.0;
+        n.y = 0.0;
+        n.z = 0.0;
+    } else
+    {
+        n.x /= d;
+        n.y /= d;
+        n.z /= d;
+    }
+    return n;
+}
+
+/*!
+ * \brief Circles of all sectors, cos() and sin() per vertex.
+ *
+ * Baseline, the former cWormhole::genCircles().
+ */
+static void baselineCircles(cWormhole &wormhole)
+{
+    const double Pi = 3.14159265358979323846;
+    int whSectors = wormhole.whSectors;
+    int circleSectors = wormhole.circleSectors;
+    for(int i = 0; i < whSectors; i++)
+    {
+        sPoint3 a = wormhole.splinePoint(i);
+        // last circle is directed the same way as the one before it
+        sPoint3 pointA = (i+1 < whSectors) ? wormhole.splinePoint(i)
+                                           : wormhole.splinePoint(i-1);
+        sPoint3 pointB = (i+1 < whSectors) ? wormhole.splinePoint(i+1)
+                                           : wormhole.splinePoint(i);
+
+        float w0 = pointB.x - pointA.x;
+        float w1 = pointB.y - pointA.y;
+        float w2 = pointB.z - pointA.z;
+        float w3d = sqrt(w0*w0 + w1*w1 + w2*w2);
+        w0 /= w3d;
+        w1 /= w3d;
+        w2 /= w3d;
+
+        float factor = 1/sqrt(w0*w0 + w2*w2);
+        float u0 = -w2*factor;
+        float u1 = 0;
+        float u2 = w0*factor;
+        float v0 = w1*u2 - w2*u1;
+        float v1 = w2*u0 - w0*u2;
+        float v2 = w0*u1 - w1*u0;
+
+        float r = wormhole.radius(i);
+        sPoint3 * ring = wormhole.circle(i);
+        for(int j = 0; j < circleSectors; j++)
+        {
+            double angle = (j * 2 * Pi) / circleSectors;
+            ring[j].x = a.x + (r*cos(angle))*u0 + (r*sin(angle))*v0;
+            ring[j].y = a.y + (r*cos(angle))*u1 + (r*sin(angle))*v1;
+            ring[j].z = a.z + (r*cos(angle))*u2 + (r*sin(angle))*v2;
+        }
+    }
+}
+
+/*!
+ * \brief Normals of all sectors, face normals scattered to their vertices.
+ *
+ * Baseline, the former cWormhole::genNormals().
+ */
+static void baselineNormals(cWormhole &wormhole)
+{
+    int whSectors = wormhole.whSectors;
+    int circleSectors = wormhole.circleSectors;
+    for(int j = 0; j < whSectors; j++)
+        for(int i = 0; i < circleSectors; i++)
+        {
+            wormhole.normals(j)[i].x = 0.0;
+            wormhole.normals(j)[i].y = 0.0;
+            wormhole.normals(j)[i].z = 0.0;
+        }
+
+    for(int j = 0; j < whSectors - 1; j++)
+    {
+        sPoint3 * circle0 = wormhole.circle(j);
+        sPoint3 * circle1 = wormhole.circle(j+1);
+        sPoint3 * normals0 = wormhole.normals(j);
+        sPoint3 * normals1 = wormhole.normals(j+1);
+        for(int i = 0; i < circleSectors; i++)
+        {
+            int next = (i+1 < circleSectors) ? i+1 : 0;
+            sPoint3 n = baselineFaceNormal(circle0[i], circle1[i],
+                                           circle1[next]);
+            normals0[i].x += n.x;
+            normals0[i].y += n.y;
+            normals0[i].z += n.z;
+            normals0[next].x += n.x;
+            normals0[next].y += n.y;
+            normals0[next].z += n.z;
+            normals1[i].x += n.x;
+            normals1[i].y += n.y;
+            normals1[i].z += n.z;
+            normals1[next].x += n.x;
+            normals1[next].y += n.y;
+            normals1[next].z += n.z;
+        }
+    }
+
+    for(int j = 0; j < whSectors; j++)
+    {
+        sPoint3 * ring = wormhole.normals(j);
+        for(int i = 0; i < circleSectors; i++)
+        {
+            float d = sqrt(ring[i].x*ring[i].x + ring[i].y*ring[i].y +
+                           ring[i].z*ring[i].z);
+            if(d == 0.0)
+            {
+                ring[i].x = 1.0;
+                ring[i].y = 0.0;
+                ring[i].z = 0.0;
+            } else
+            {
+                ring[i].x /= d;
+                ring[i].y /= d;
+                ring[i].z /= d;
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Copies circles (or normals) of all sectors out of the front store.
+ */
+static QVector<sPoint3> snapshot(cWormhole &wormhole, bool bNormals)
+{
+    QVector<sPoint3> points;
+    for(int j = 0; j < wormhole.whSectors; j++)
+    {
+        const sPoint3 * ring = bNormals ? wormhole.normals(j)
+                                        : wormhole.circle(j);
+        for(int i = 0; i < wormhole.circleSectors; i++)
+            points.append(ring[i]);
+    }
+    return points;
+}
+
+/*!
+ * \brief Largest difference of coordinates of two snapshots.
+ */
+static float maxDifference(const QVector<sPoint3> &a,
+                           const QVector<sPoint3> &b)
+{
+    float d = 0.0;
+    for(int i = 0; i < a.size(); i++)
+    {
+        d = qMax(d, (float) fabs(a.at(i).x - b.at(i).x));
+        d = qMax(d, (float) fabs(a.at(i).y - b.at(i).y));
+        d = qMax(d, (float) fabs(a.at(i).z - b.at(i).z));
+    }
+    return d;
+}
+
+/*!
+ * \class cWormholeBench
+ * \brief Times the generators of cWormhole on its front store.
+ *
+ * Every kernel is run in benchBatches batches of benchRuns runs, time of one
+ * run of the fastest batch in ms is returned.
+ */
+class cWormholeBench
+{
+public:
+    enum eKernel { BaselineCircles, BaselineNormals, Circles, Normals };
+
+    static double time(cWormhole &wormhole, eKernel kernel)
+    {
+        int best = -1;
+        for(int b = 0; b < benchBatches; b++)
+        {
+            QTime time;
+            time.start();
+            for(int r = 0; r < benchRuns; r++)
+                run(wormhole, kernel);
+            int elapsed = time.elapsed();
+            if(best < 0 || elapsed < best)
+                best = elapsed;
+        }
+        return (double) best / benchRuns;
+    }
+
+private:
+    static void run(cWormhole &wormhole, eKernel kernel)
+    {
+        switch(kernel)
+        {
+        case BaselineCircles:
+            baselineCircles(wormhole);
+            break;
+        case BaselineNormals:
+            baselineNormals(wormhole);
+            break;
+        case Circles:
+            wormhole.genCircles(*wormhole.front, 0, wormhole.whSectors);
+            break;
+        case Normals:
+            wormhole.genNormals(*wormhole.front, 0, wormhole.whSectors);
+            break;
+        }
+    }
+};
+
+/*!
+ * \brief Prints times of baseline and vectorised kernel and how far apart
+ * their results are.
+ */
+static void report(const char * kernel, const char * path, double before,
+                   double after, float difference)
+{
+    printf("%s: baseline %.3f ms, %s %.3f ms, %.1fx faster, "
+           "max difference %g\n", kernel, before, path, after,
+           after > 0.0 ? before / after : 0.0, difference);
+}
+
+int main(int argc, char *argv[])
+{
+    // cWormhole is a QGLWidget
+    QApplication app(argc, argv);
+
+    // shape of the wormhole is random, cost of the kernels does not depend on
+    // it
+    cWormhole wormhole;
+    wormhole.updateObject(benchWhSectors, benchCircleSectors);
+
+#ifdef WH_NO_SIMD
+    const char * path = "scalar";
+#else
+    const char * path = "sse";
+#endif
+    printf("%s %dx%d, best of %d batches of %d runs\n", path,
+           wormhole.whSectors, wormhole.circleSectors, benchBatches,
+           benchRuns);
+
+    double before = cWormholeBench::time(wormhole,
+                                         cWormholeBench::BaselineCircles);
+    QVector<sPoint3> circlesBefore = snapshot(wormhole, false);
+    double after = cWormholeBench::time(wormhole, cWormholeBench::Circles);
+    QVector<sPoint3> circlesAfter = snapshot(wormhole, false);
+    report("genCircles", path, before, after,
+           maxDifference(circlesBefore, circlesAfter));
+
+    // both normal kernels work on the same circles
+    before = cWormholeBench::time(wormhole, cWormholeBench::BaselineNormals);
+    QVector<sPoint3> normalsBefore = snapshot(wormhole, true);
+    after = cWormholeBench::time(wormhole, cWormholeBench::Normals);
+    QVector<sPoint3> normalsAfter = snapshot(wormhole, true);
+    report("genNormals", path, before, after,
+           maxDifference(normalsBefore, normalsAfter));
+    return 0;
+}
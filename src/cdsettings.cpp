@@ -156,6 +156,22 @@ void cDSettings::evalSettings()
         parentCWidget->settings_navigation = false;
     }
 
+    if(checkBox_hullCollision->isChecked())
+    {
+        parentCWidget->settings_hullCollision = true;
+    } else
+    {
+        parentCWidget->settings_hullCollision = false;
+    }
+
+    if(checkBox_winding->isChecked())
+    {
+        parentCWidget->settings_winding = true;
+    } else
+    {
+        parentCWidget->settings_winding = false;
+    }
+
     if(radioButton_smallship->isChecked())
     {
         if(parentCWidget->settings_object != QString("small_ship.obj"))
@@ -227,6 +243,22 @@ void cDSettings::setSettingsDialog()
         checkBox_navigation->setChecked(false);
     }
 
+    if(parentCWidget->settings_hullCollision)
+    {
+        checkBox_hullCollision->setChecked(true);
+    } else
+    {
+        checkBox_hullCollision->setChecked(false);
+    }
+
+    if(parentCWidget->settings_winding)
+    {
+        checkBox_winding->setChecked(true);
+    } else
+    {
+        checkBox_winding->setChecked(false);
+    }
+
     if(parentCWidget->settings_object == QString("small_ship.obj"))
     {
         radioButton_ownship->setChecked(false);
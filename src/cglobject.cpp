@@ -12,6 +12,8 @@
 #include "cobj2ogl.h"
 #include "cglobject.h"
 
+#include <stddef.h>
+
 /*!
  * \brief Constructor of cGLObject.
  *
@@ -20,22 +22,24 @@
 cGLObject::cGLObject()
 {
     // initializing data
-    object = 0;
 
     green = QColor::fromCmykF(0.40, 0.0, 1.0, 0.0);
     purple = QColor::fromCmykF(0.39, 0.39, 0.0, 0.0);
 
-    obj2OGL = new cObj2OGL();
+    obj2OGL = QSharedPointer<cObj2OGL>(new cObj2OGL());
+
+    bPackedVertices = false;
+    resetPacking();
+    indexType = GL_UNSIGNED_INT;
 }
 
 /*!
  * \brief Destructor of cGLObject.
  *
- * Deleting obj2OGL object.
+ * obj2OGL object is deleted with its last holder, see cMeshCache.
  */
 cGLObject::~cGLObject()
 {
-    delete obj2OGL;
 }
 
 /*!
@@ -49,60 +53,102 @@ cGLObject::~cGLObject()
 cGLObject::cGLObject(QString str)
 {
     // initializing data
-    object = 0;
     objFile = str;
 
     green = QColor::fromCmykF(0.40, 0.0, 1.0, 0.0);
     purple = QColor::fromCmykF(0.39, 0.39, 0.0, 0.0);
 
-    obj2OGL = new cObj2OGL();
+    obj2OGL = QSharedPointer<cObj2OGL>(new cObj2OGL());
+
+    bPackedVertices = false;
+    resetPacking();
+    indexType = GL_UNSIGNED_INT;
 }
 
 /*!
- * \brief Auxiliary method.
+ * \brief Sets vertex, normal and texture coordinate arrays.
  *
- * Helpful method for rendering quad. Will be used in cWormhole.
+ * Arrays are taken from the bound vertex buffer of sVertex structures, or
+ * sPackedVertex structures if bPackedVertices is set. Packed positions and
+ * texture coordinates are mapped back by modelview and texture matrices,
+ * normals are normalized by GL. Used by cUfo::draw() and cWormhole::draw().
  */
-void cGLObject::quad(sPoint3 normal1, sPoint3 point1,
-                     sPoint3 normal2, sPoint3 point2,
-                     sPoint3 normal3, sPoint3 point3,
-                     sPoint3 normal4, sPoint3 point4)
+void cGLObject::enableVertexArrays()
 {
-    glNormal3f(normal1.x, normal1.y, normal1.z);
-    glTexCoord2f(0.0, 0.0);
-    glVertex3f(point1.x, point1.y, point1.z);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
-    glNormal3f(normal2.x, normal2.y, normal2.z);
-    glTexCoord2f(0.0, 2.0);
-    glVertex3f(point2.x, point2.y, point2.z);
+    if(!bPackedVertices)
+    {
+        glVertexPointer(3, GL_FLOAT, sizeof(sVertex),
+                        (const GLvoid *) offsetof(sVertex, x));
+        glNormalPointer(GL_FLOAT, sizeof(sVertex),
+                        (const GLvoid *) offsetof(sVertex, nx));
+        glTexCoordPointer(2, GL_FLOAT, sizeof(sVertex),
+                          (const GLvoid *) offsetof(sVertex, s));
+        return;
+    }
 
-    glNormal3f(normal3.x, normal3.y, normal3.z);
-    glTexCoord2f(2.0, 2.0);
-    glVertex3f(point3.x, point3.y, point3.z);
+    glVertexPointer(3, GL_SHORT, sizeof(sPackedVertex),
+                    (const GLvoid *) offsetof(sPackedVertex, x));
+    glNormalPointer(GL_BYTE, sizeof(sPackedVertex),
+                    (const GLvoid *) offsetof(sPackedVertex, nx));
+    glTexCoordPointer(2, GL_SHORT, sizeof(sPackedVertex),
+                      (const GLvoid *) offsetof(sPackedVertex, s));
 
-    glNormal3f(normal4.x, normal4.y, normal4.z);
-    glTexCoord2f(2.0, 0.0);
-    glVertex3f(point4.x, point4.y, point4.z);
+    // texture matrix stack may be only 2 deep, cWormhole::draw() uses it
+    if(packing.texOffset[0] != 0.0 || packing.texOffset[1] != 0.0 ||
+       packing.texScale != 1.0)
+    {
+        glMatrixMode(GL_TEXTURE);
+        glPushMatrix();
+        glTranslatef(packing.texOffset[0], packing.texOffset[1], 0.0);
+        glScalef(packing.texScale, packing.texScale, 1.0);
+    }
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glTranslatef(packing.offset[0], packing.offset[1], packing.offset[2]);
+    glScalef(packing.scale, packing.scale, packing.scale);
 }
 
 /*!
- * \brief Auxiliary method.
- *
- * Helpful method for rendering triangle. Will be used in cWormhole.
+ * \brief Disables arrays set by cGLObject::enableVertexArrays().
  */
-void cGLObject::triangle(sPoint3 normal1, sPoint3 point1,
-                         sPoint3 normal2, sPoint3 point2,
-                         sPoint3 normal3, sPoint3 point3)
+void cGLObject::disableVertexArrays()
 {
-    glNormal3f(normal1.x, normal1.y, normal1.z);
-    glTexCoord2f(0.0, 0.0);
-    glVertex3f(point1.x, point1.y, point1.z);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    if(!bPackedVertices) return;
+
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    if(packing.texOffset[0] != 0.0 || packing.texOffset[1] != 0.0 ||
+       packing.texScale != 1.0)
+    {
+        glMatrixMode(GL_TEXTURE);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+    }
+}
 
-    glNormal3f(normal2.x, normal2.y, normal2.z);
-    glTexCoord2f(0.0, 1.0);
-    glVertex3f(point2.x, point2.y, point2.z);
+/*!
+ * \brief Sets packing that keeps coordinates as they are.
+ */
+void cGLObject::resetPacking()
+{
+    packing.offset[0] = packing.offset[1] = packing.offset[2] = 0.0;
+    packing.scale = 1.0;
+    packing.texOffset[0] = packing.texOffset[1] = 0.0;
+    packing.texScale = 1.0;
+}
 
-    glNormal3f(normal3.x, normal3.y, normal3.z);
-    glTexCoord2f(1.0, 1.0);
-    glVertex3f(point3.x, point3.y, point3.z);
+/*!
+ * \brief Bytes of one index of indexType.
+ */
+int cGLObject::indexSize() const
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
 }
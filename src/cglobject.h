@@ -16,6 +16,7 @@
 
 
 #include <QGLWidget>
+#include <QSharedPointer>
 
 //class cObj2OGL;
 
@@ -24,8 +25,9 @@
  * \class cGLObject
  * \brief Basic model for every openGL object in scene (wormhole, ufo, etc.).
  *
- * This object supplies 2 virtual functions for its descendants. One for
- * just creating display list and second for making object by parsing obj file.
+ * This object supplies 3 virtual functions for its descendants. One for
+ * making object by parsing obj file, one for uploading it to the graphics
+ * card (display list or vertex buffers) and one for drawing it.
  * This so called parsing will be achieved by creating and using cObj2OGL
  * instance.
  */
@@ -38,26 +40,27 @@ public:
     //virtual GLuint makeObject() =0;
     virtual void makeObject(QProgressBar * progress_bar = NULL,
                             QLabel * progress_label = NULL) =0;
-    virtual GLuint makeDisplayList(int polygons = 0) =0;
+    virtual void makeBuffers() =0;
+    virtual void draw(int polygons = 0) =0;
     //virtual GLuint makeObject(QProgressDialog * progress_dialog = NULL) =0;
     //virtual void updateObject() =0;
 
-    int nLists;
     QString objFile;
-    GLuint object;
-    cObj2OGL *obj2OGL;
+    QSharedPointer<cObj2OGL> obj2OGL;
 
     QColor green;
     QColor purple;
 
-//protected:
-    void quad(sPoint3 normal1, sPoint3 point1,\
-              sPoint3 normal2, sPoint3 point2,\
-              sPoint3 normal3, sPoint3 point3,\
-              sPoint3 normal4, sPoint3 point4);
-    void triangle(sPoint3 normal1, sPoint3 point1,\
-                  sPoint3 normal2, sPoint3 point2,\
-                  sPoint3 normal3, sPoint3 point3);
+    // vertex buffer holds sPackedVertex instead of sVertex
+    bool bPackedVertices;
+    sVertexPacking packing;
+    GLenum indexType;  // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT indices
+
+protected:
+    void enableVertexArrays();
+    void disableVertexArrays();
+    void resetPacking();
+    int indexSize() const;
 
 };
 
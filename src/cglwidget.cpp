@@ -20,27 +20,22 @@
 #endif
 
 #include "vec3.h"
+#include "quat.h"
+#include "mat4.h"
 #include "cmainwindow.h"
 #include "cglobject.h"
 #include "cufo.h"
 #include "cwormhole.h"
 #include "cglwidget.h"
 
-// Space Ship Mode matrix
-GLdouble ssmMatrix[16] = {1, 0, 0, 0,
-                          0, 1, 0, 0,
-                          0, 0, 1, 0,
-                          0, 0, 0, 1};
+// Space Ship Mode orientation of ufo
+quat ssmRotation;
+// Space Ship Mode matrix, ssmRotation moved to ufo position
+mat4 ssmMatrix;
 // Free Look Mode matrix
-GLdouble flmMatrix[16] = {1, 0, 0, 0,
-                          0, 1, 0, 0,
-                          0, 0, 1, 0,
-                          0, 0, 0, 1};
-// Temporary matrix used for some auxiliary calculations
-GLdouble tmpMatrix[16] = {1, 0, 0, 0,
-                          0, 1, 0, 0,
-                          0, 0, 1, 0,
-                          0, 0, 0, 1};
+mat4 flmMatrix;
+// Positions of ufo hull tested along one step, see cGLWidget::hullCollision()
+static const int maxHullSteps = 8;
 
 /*!
  * \brief One of the most important consructors in this application.
@@ -72,6 +67,8 @@ cGLWidget::cGLWidget(QGLFormat fmt, cMainWindow *parent)
 
     score = 0;
     collision = 0;
+    bLastUfoPos = false;
+    impactTime = -1.0;
 
     fps = 0;
     strFps = QString(" FPS: %1").arg(fps, 0, 10);
@@ -120,20 +117,26 @@ cGLWidget::cGLWidget(QGLFormat fmt, cMainWindow *parent)
 
     /* GAME OBJECTS */
     wormhole = new cWormhole;
-    ufo = new cUfo(parentCWidget->settings_object);
 
+    // placeholder ship is flown until the real one is loaded in background
+    ufo = new cUfo();
     ufo->radius = 0.01;
     ufo->pos.x = ufo->pos.y = ufo->pos.z = 0.0;
+    ufo->makePlaceholder();
+
+    ufoLoading = new cUfo(parentCWidget->settings_object);
+    ufoLoading->startLoading();
 
     bFirstInit = GL_TRUE;
 
+    wormhole->bWinding = parentCWidget->settings_winding;
     wormhole->makeObject();
 
-    ufo->makeObject(parentCWidget->progressbar_glWidget,
-                    parentCWidget->label_progressbar);
-
-    //obj1->makeObject(parentCWidget->progressbar_glWidget,
-    //                 parentCWidget->label_progressbar);
+    // loading progress timer, see checkLoading()
+    lastLoadProgress = -1;
+    loadTimer.setSingleShot(false);
+    connect(&loadTimer, SIGNAL(timeout()), this, SLOT(checkLoading()));
+    loadTimer.start(16);
 
     // setting object comunicating with widgets
     //parentCWidget->whSectorsSlider->setValue(wormhole->whSectors);
@@ -142,11 +145,11 @@ cGLWidget::cGLWidget(QGLFormat fmt, cMainWindow *parent)
 }
 
 /*!
- * \brief Destroys textures, display lists and scene objects.
+ * \brief Destroys textures, vertex buffers and scene objects.
  *
  * Very importatnt destructor. Freeing memory in a place such as this is duty.
  * Not freeing memory in a place such as this may result in serious application
- * malfunctions. Textures, display lists and instances of cUfo and cWormhole
+ * malfunctions. Textures, vertex buffers and instances of cUfo and cWormhole
  * are properly freed in this method.
  */
 cGLWidget::~cGLWidget()
@@ -156,13 +159,11 @@ cGLWidget::~cGLWidget()
     // textures
     glDeleteTextures( 1, &textureWormhole);
 
-    // display lists
-    glDeleteLists(wormhole->object, 1);
-    glDeleteLists(ufo->object, 1);
-    //glDeleteLists(obj1->object, 1);
+    // vertex buffers are freed by their objects
 
     delete wormhole;
     delete ufo;
+    delete ufoLoading; // preloaded mesh stays in cMeshCache
     //delete obj1;
 
 }
@@ -264,9 +265,8 @@ void cGLWidget::initializeGL()
         if(LoadTextureFromBMP("./images/wormhole_texture.bmp", textureWormhole))
             glBindTexture(GL_TEXTURE_2D, textureWormhole);
 
-        wormhole->object =
-            wormhole->makeDisplayList(parentCWidget->settings_polygons);
-        ufo->object = ufo->makeDisplayList();
+        wormhole->makeBuffers();
+        ufo->makeBuffers();
         //obj1->object = obj1->makeDisplayList();
         //obj2->object = obj2->makeDisplayList();
         //obj3->object = obj3->makeDisplayList();
@@ -306,6 +306,9 @@ void cGLWidget::resizeGL(int w, int h)
  * consider development of these improvements beneficial or not, compared to the
  * invested energy and time.
  *
+ * Pose of the ufo and the camera are computed by mat4 and quat, matrices are
+ * only loaded to OpenGL, never read back from it.
+ *
  * \sa cGLWidget::initializeGL(), cGLWidget::resizeGL()
  */
 void cGLWidget::paintGL()
@@ -338,48 +341,43 @@ void cGLWidget::paintGL()
 
     if(bPause) // free look mode
     {
-        glLoadIdentity();
         if ((flmXrot != 0.0) || (flmYrot != 0.0) || (flmZrot != 0.0) ||
             (flmX != 0.0) || (flmY != 0.0) || (flmZ != 0.0)) {
+            mat4 look;
             if (flmXrot != 0.0)
             {
-                glRotatef(flmXrot/16., 1,0,0);
+                look *= mat4::Rotation(flmXrot/16., 1,0,0);
                 flmXrot = 0.0;
             }
             if (flmYrot != 0.0)
             {
-                glRotatef(flmYrot/16., 0,1,0);
+                look *= mat4::Rotation(flmYrot/16., 0,1,0);
                 flmYrot = 0.0;
             }
             if (flmZrot != 0.0)
             {
-                glRotatef(flmZrot/16., 0,0,1);
+                look *= mat4::Rotation(flmZrot/16., 0,0,1);
                 flmZrot = 0.0;
             }
-            //glTranslatef (0, 0, 0.1);
-            glTranslatef(flmX, flmY, flmZ);
+            look *= mat4::Translation(flmX, flmY, flmZ);
             flmX = flmY = flmZ = 0.0;
-            //glTranslatef (0, 0, -0.1);
-            glMultMatrixd(flmMatrix);
-            glGetDoublev(GL_MODELVIEW_MATRIX, flmMatrix);
+            flmMatrix = look * flmMatrix;
         }
 
-        // paint scene
-        glLoadIdentity();
-        glMultMatrixd (flmMatrix);
+        // draw ufo, its distance from camera is translation of flm * ssm
+        mat4 ufoMatrix = flmMatrix * ssmMatrix;
+        ufo->selectLod(ufoPixelRadius(ufoMatrix.Position().Magnitude()));
+        glLoadMatrixd(ufoMatrix.Data());
+        qglColor(QColor::fromRgb(150, 150, 150));
+        ufo->draw();
 
-        // draw ufo
-        glPushMatrix();
-//            glTranslatef (0.0, 0.0, -0.1); // move object away from camera
-            glMultMatrixd(ssmMatrix);
-            qglColor(QColor::fromRgb(150, 150, 150));
-            glCallList(ufo->object);
-        glPopMatrix();
+        // paint scene
+        glLoadMatrixd(flmMatrix.Data());
 
         // draw wormhole
         glBindTexture(GL_TEXTURE_2D, textureWormhole);
         glEnable(GL_TEXTURE_2D);
-            glCallList(wormhole->object);
+            wormhole->draw(parentCWidget->settings_polygons);
         glDisable(GL_TEXTURE_2D);
 
         // draw spline dots in wormhole (navigation)
@@ -391,9 +389,9 @@ void cGLWidget::paintGL()
             glBegin(GL_POINTS);
                 for (int i=0; i<wormhole->whSectors; i++)
                 {
-                    glVertex3f(wormhole->sectors[i].splinePoint.x,
-                               wormhole->sectors[i].splinePoint.y,
-                               wormhole->sectors[i].splinePoint.z);
+                    glVertex3f(wormhole->splinePoint(i).x,
+                               wormhole->splinePoint(i).y,
+                               wormhole->splinePoint(i).z);
                 }
             glEnd();
             glPointSize(1.0);
@@ -403,59 +401,53 @@ void cGLWidget::paintGL()
     else // space ship mode
     {
         // local rotation and translation of objects (ufo, ..) and camera
-        glLoadMatrixd(ssmMatrix);
-            glRotatef(objXrot, 1.0, 0.0, 0.0);
-            glRotatef(objZrot, 0.0, 0.0, 1.0);
-            glTranslatef(0,0,objForward);
-        glGetDoublev(GL_MODELVIEW_MATRIX, ssmMatrix);
+        ssmRotation *= quat(objXrot, vec3(1.0, 0.0, 0.0)) *
+                       quat(objZrot, vec3(0.0, 0.0, 1.0));
+        ssmRotation.Normalize();
+        vec3 pos(ufo->pos.x, ufo->pos.y, ufo->pos.z);
+        pos += ssmRotation.Rotate(vec3(0.0, 0.0, objForward));
+        ssmMatrix = mat4(ssmRotation, pos);
 
         // object position
-        ufo->pos.x = ssmMatrix[12];
-        ufo->pos.y = ssmMatrix[13];
-        ufo->pos.z = ssmMatrix[14];
-
-        glLoadMatrixd(ssmMatrix);
-            glTranslatef(0.0, 0.0, 0.001);
-        glGetDoublev(GL_MODELVIEW_MATRIX, tmpMatrix);
+        ufo->pos.x = pos.x;
+        ufo->pos.y = pos.y;
+        ufo->pos.z = pos.z;
 
-        // eye position (used in gluLookAt() function)
-        camX = tmpMatrix[12];
-        camY = tmpMatrix[13];
-        camZ = tmpMatrix[14];
-
-        glLoadMatrixd(ssmMatrix);
-            glTranslatef(0.0, 1.00, 0.0);
-        glGetDoublev(GL_MODELVIEW_MATRIX, tmpMatrix);
+        // eye position (used in camera look at)
+        vec3 eye = ssmMatrix.TransformPoint(vec3(0.0, 0.0, 0.001));
+        camX = eye.x;
+        camY = eye.y;
+        camZ = eye.z;
 
         // up vector shall not move with object, just rotate
-        upX = tmpMatrix[12] - ufo->pos.x;
-        upY = tmpMatrix[13] - ufo->pos.y;
-        upZ = tmpMatrix[14] - ufo->pos.z;
+        vec3 up = ssmRotation.Rotate(vec3(0.0, 1.0, 0.0));
+        upX = up.x;
+        upY = up.y;
+        upZ = up.z;
 
         objXrot = objZrot = 0.0;
         objForward = 0.0;
 
         // paint scene
-        glLoadIdentity();
+        mat4 view = mat4::Translation(0.0, 0.0,
+                                      -(ufo->radius*12.0)+objCamZoom) *
+                    mat4::Rotation(objCamXrot/16, 1.0, 0.0, 0.0) *
+                    mat4::Rotation(objCamYrot/16, 0.0, 1.0, 0.0);
 
         // draw ufo
-        glTranslatef (0.0, 0.0, -(ufo->radius*12.0)+objCamZoom);
-        glRotatef(objCamXrot/16, 1.0, 0.0, 0.0);
-        glRotatef(objCamYrot/16, 0.0, 1.0, 0.0);
-        glPushMatrix();
-            glRotatef(effectXrot, 1.0, 0.0, 0.0);
-            glRotatef(effectZrot, 0.0, 0.0, 1.0);
-            qglColor(QColor::fromRgb(150, 150, 150));
-            glCallList(ufo->object);
-        glPopMatrix();
+        glLoadMatrixd((view * mat4::Rotation(effectXrot, 1.0, 0.0, 0.0) *
+                       mat4::Rotation(effectZrot, 0.0, 0.0, 1.0)).Data());
+        qglColor(QColor::fromRgb(150, 150, 150));
+        ufo->selectLod(ufoPixelRadius(ufo->radius*12.0 - objCamZoom));
+        ufo->draw();
 
         // set camera
-        gluLookAt(camX, camY, camZ, ufo->pos.x, ufo->pos.y, ufo->pos.z, upX, upY, upZ);
+        glLoadMatrixd((view * mat4::LookAt(eye, pos, up)).Data());
 
         // draw wormhole
         glBindTexture(GL_TEXTURE_2D, textureWormhole);
         glEnable(GL_TEXTURE_2D);
-            glCallList(wormhole->object);
+            wormhole->draw(parentCWidget->settings_polygons);
         glDisable(GL_TEXTURE_2D);
 
         // draw spline dots in wormhole (avigation)
@@ -466,9 +458,9 @@ void cGLWidget::paintGL()
             glBegin(GL_POINTS);
                 for (int i=0; i<wormhole->whSectors; i++)
                 {
-                    glVertex3f(wormhole->sectors[i].splinePoint.x,
-                               wormhole->sectors[i].splinePoint.y,
-                               wormhole->sectors[i].splinePoint.z);
+                    glVertex3f(wormhole->splinePoint(i).x,
+                               wormhole->splinePoint(i).y,
+                               wormhole->splinePoint(i).z);
                 }
             glEnd();
             glPointSize(1.0);
@@ -483,19 +475,189 @@ void cGLWidget::paintGL()
 }
 
 /*!
- * \brief Calculates distance between line and point.
+ * \brief Radius of ufo on screen in pixels.
  *
- * Calculates distance between line and point using cross product technique.
+ * Bounds of ufo mesh are projected by the 45 degree perspective set in
+ * cGLWidget::resizeGL().
+ *
+ * \param distance distance of ufo from camera
  */
-float cGLWidget::pointToLineDistance(sPoint3 point, sPoint3 A, sPoint3 B)
+float cGLWidget::ufoPixelRadius(double distance)
 {
-    float d;
-    //d = fabs((x0 - x1) x (x0 - x2))/fabs(x2 - x1)
-    vec3 x01(point.x - A.x, point.y - A.y, point.z - A.z);
-    vec3 x02(point.x - B.x, point.y - B.y, point.z - B.z);
-    vec3 x21(B.x - A.x, B.y - A.y, B.z - A.z);
-    d = fabs(x01.CrossProduct(x02).Magnitude())/fabs(x21.Magnitude());
-    return d;
+    if(distance <= 0.0) return height;
+
+    return ufo->meshRadius / (distance*tan(22.5*piover180)) * height/2.0;
+}
+
+/*!
+ * \brief Clips time t0 ... t1 to where f0 + t*(f1 - f0) is not negative.
+ *
+ * \return false if no time is left.
+ */
+static bool clipStep(float f0, float f1, float &t0, float &t1)
+{
+    if(f0 < 0.0 && f1 < 0.0) return false;
+    if(f0 < 0.0)
+        t0 = qMax(t0, f0/(f0 - f1));
+    else if(f1 < 0.0)
+        t1 = qMin(t1, f0/(f0 - f1));
+    return t0 <= t1;
+}
+
+/*!
+ * \brief Swept collision of ufo moving from one position to another.
+ *
+ * Ufo sphere of shipRadius moves along the segment from-to, every sector it
+ * crosses is tested by cGLWidget::sectorImpact() for the part of the segment
+ * inside it, that is between planes of its spline points (see
+ * cWormhole::planeDistance()). Sectors between those of from and to are
+ * tested, they are found by sectorCursor and the cursor ends at the sector of
+ * to.
+ *
+ * \param bNarrowest sector is as narrow as its narrowest end or that of its
+ * neighbours, so that the sphere bounds anything cGLWidget::hullCollision()
+ * may find
+ * \return time of impact, 0 at from and 1 at to, or -1 if there is no
+ * collision.
+ */
+float cGLWidget::sweepCollision(sPoint3 from, sPoint3 to, float shipRadius,
+                                bool bNarrowest)
+{
+    vec3 a(from.x, from.y, from.z);
+    vec3 b(to.x, to.y, to.z);
+    int last = wormhole->whSectors - 2;
+
+    int j0 = sectorCursor.locate(wormhole, from);
+    int j1 = sectorCursor.locate(wormhole, to);
+    if(j0 > j1) qSwap(j0, j1);
+
+    float impact = -1.0;
+    for(int j = j0; j <= j1; j++)
+    {
+        // distance from a plane goes linearly with time, ufo is in the sector
+        // while beyond plane j-1 and not beyond plane j
+        float t0 = 0.0, t1 = 1.0;
+        if(!clipStep(wormhole->planeDistance(j-1, from),
+                     wormhole->planeDistance(j-1, to), t0, t1) ||
+           !clipStep(-wormhole->planeDistance(j, from),
+                     -wormhole->planeDistance(j, to), t0, t1))
+            continue;
+
+        float wall = wormhole->radius(j-1);
+        if(bNarrowest)
+            for(int k = qMax(j-2, 0); k <= qMin(j+1, last+1); k++)
+                wall = qMin(wall, wormhole->radius(k));
+
+        float t = sectorImpact(j, a, b, wall - shipRadius, t0, t1);
+        if(t >= 0.0 && (impact < 0.0 || t < impact))
+            impact = t;
+    }
+
+    return impact;
+}
+
+/*!
+ * \brief Earliest time within t0 ... t1 when ufo moving from-to touches wall
+ * of sector j.
+ *
+ * Squared distance of the ufo from axis of the sector, |(p(t) - s) x u|^2
+ * with p(t) = from + t*(to - from), is quadratic in t. It is compared to the
+ * squared room of the ufo (radius of the sector reduced by ufo radius), so
+ * the time of impact is a root of a quadratic equation.
+ *
+ * \return time of impact or -1.
+ */
+float cGLWidget::sectorImpact(int j, const vec3 &from, const vec3 &to,
+                              float room, float t0, float t1)
+{
+    sPoint3 s0 = wormhole->splinePoint(j-1);
+    sPoint3 s1 = wormhole->splinePoint(j);
+    vec3 u(s1.x - s0.x, s1.y - s0.y, s1.z - s0.z);
+    u.Normalize();
+
+    if(room <= 0.0) return t0;
+
+    vec3 w0 = (from - vec3(s0.x, s0.y, s0.z)).CrossProduct(u);
+    vec3 w1 = (to - from).CrossProduct(u);
+    // d^2(t) - room^2 = a*t^2 + 2*b*t + c
+    float a = w1.Dot(w1);
+    float b = w0.Dot(w1);
+    float c = w0.Dot(w0) - room*room;
+
+    if(a*t0*t0 + 2.0*b*t0 + c >= 0.0) return t0;
+    if(a == 0.0) return -1.0;
+
+    // ufo is inside at t0, it leaves at the greater root
+    float t = (-b + sqrt(qMax(b*b - a*c, 0.0f)))/a;
+    if(t > t1) return -1.0;
+    return qMax(t, t0);
+}
+
+/*!
+ * \brief Narrow phase of collision, hull of ufo against walls of wormhole.
+ *
+ * Hull points of the ufo, rotated by ssmMatrix, are placed at positions along
+ * the step from-to, starting at time start where its bounding sphere touches
+ * a wall (see cGLWidget::sweepCollision()). Positions are at most hullRadius
+ * apart, up to maxHullSteps of them. At each position the points are tested
+ * against every sector they may reach by cWormhole::touchesWall(). Sectors
+ * are those whose boxes overlap the hull (see cWormhole::sectorsNear()) and
+ * which are not too far along the wormhole from sector of the position,
+ * another pass of winding wormhole may be close in space. Sectors of the
+ * positions are found by a copy of sectorCursor, so that sectorCursor is left
+ * at the sector of to.
+ *
+ * \return time of the first position where the hull touches a wall, or -1.
+ */
+float cGLWidget::hullCollision(sPoint3 from, sPoint3 to, float start)
+{
+    const QVector<sPoint3> &hull = ufo->hull;
+    int n = hull.size();
+    hullX.resize(n);
+    hullY.resize(n);
+    hullZ.resize(n);
+
+    float dx = to.x - from.x;
+    float dy = to.y - from.y;
+    float dz = to.z - from.z;
+    float travel = (1.0 - start)*sqrt(dx*dx + dy*dy + dz*dz);
+    int steps = qBound(1, (int) ceil(travel/ufo->hullRadius), maxHullSteps);
+    float r = ufo->hullRadius;
+    cSectorCursor cursor = sectorCursor;
+
+    for(int k = 0; k <= steps; k++)
+    {
+        float t = start + (1.0 - start)*k/steps;
+        float x = from.x + t*dx;
+        float y = from.y + t*dy;
+        float z = from.z + t*dz;
+        for(int i = 0; i < n; i++)
+        {
+            const sPoint3 &p = hull.at(i);
+            hullX[i] = ssmMatrix[0]*p.x + ssmMatrix[4]*p.y +
+                       ssmMatrix[8]*p.z + x;
+            hullY[i] = ssmMatrix[1]*p.x + ssmMatrix[5]*p.y +
+                       ssmMatrix[9]*p.z + y;
+            hullZ[i] = ssmMatrix[2]*p.x + ssmMatrix[6]*p.y +
+                       ssmMatrix[10]*p.z + z;
+        }
+
+        sPoint3 pos = {x, y, z};
+        sPoint3 min = {x - r, y - r, z - r};
+        sPoint3 max = {x + r, y + r, z + r};
+        int jc = cursor.locate(wormhole, pos);
+        hullSectors.clear();
+        wormhole->sectorsNear(min, max, hullSectors);
+        for(int i = 0; i < hullSectors.size(); i++)
+        {
+            int j = hullSectors.at(i);
+            if(qAbs(j - jc) > wormhole->sectorsPerSpan) continue;
+            if(wormhole->touchesWall(j, hullX.constData(), hullY.constData(),
+                                     hullZ.constData(), n))
+                return t;
+        }
+    }
+    return -1.0;
 }
 
 /*!
@@ -724,6 +886,47 @@ void cGLWidget::animate()
     updateGL();
 }
 
+/*!
+ * \brief Polls loading of the ship.
+ *
+ * Binded to loadTimer (16 ms). Progress of loading is emitted by
+ * loadProgress() whenever it changes. Loaded ship is uploaded and swapped in
+ * place of the placeholder, then loadFinished() is emitted and the timer
+ * stops.
+ *
+ * \sa cUfo::startLoading()
+ * \note private slot
+ */
+void cGLWidget::checkLoading()
+{
+    if(ufoLoading == NULL)
+    {
+        loadTimer.stop();
+        return;
+    }
+
+    int progress = ufoLoading->loadProgress();
+    if(progress != lastLoadProgress)
+    {
+        lastLoadProgress = progress;
+        emit loadProgress(progress);
+    }
+
+    // buffers can be made only after initializeGL()
+    if(ufoLoading->isLoading() || bFirstInit) return;
+
+    makeCurrent();
+    ufoLoading->makeBuffers();
+    ufoLoading->pos = ufo->pos;
+    ufoLoading->radius = ufo->radius;
+    delete ufo;
+    ufo = ufoLoading;
+    ufoLoading = NULL;
+
+    loadTimer.stop();
+    emit loadFinished();
+}
+
 /*!
  * \brief Check for collisions.
  *
@@ -731,25 +934,36 @@ void cGLWidget::animate()
  * collision check, distance of the space ship from the nearest line created by
  * two spline point is compared to the radius of the corresponding wormhole
  * sector. The distance is adjusted to capture marginal collisions of spaceship.
+ *
+ * Whole step of the ship since the previous check is tested, not only its
+ * end, so a long frame or turbo can not skip a narrow part of the wormhole,
+ * see cGLWidget::sweepCollision(). Score is counted up to the collision.
+ *
+ * With hull collision set, the sphere bounds convex hull of the ship mesh and
+ * only hits of the sphere are tested further by cGLWidget::hullCollision().
  */
 void cGLWidget::checkCollisions()
 {
+    sPoint3 from = bLastUfoPos ? lastUfoPos : ufo->pos;
+    lastUfoPos = ufo->pos;
+    bLastUfoPos = true;
+
     collision = 0;
-    for (int j=1; j<this->wormhole->whSectors-1; j++)
+    bool bHull = parentCWidget->settings_hullCollision &&
+                 ufo->hullRadius > 0.0;
+    impactTime = sweepCollision(from, ufo->pos,
+                                bHull ? ufo->hullRadius : ufo->radius, bHull);
+    if(bHull && impactTime >= 0.0)
+        impactTime = hullCollision(from, ufo->pos, impactTime);
+    if(impactTime >= 0.0)
     {
-        if((this->wormhole->sectors[j-1].splinePoint.x < this->ufo->pos.x) &&
-           (this->ufo->pos.x < this->wormhole->sectors[j].splinePoint.x))
-        {
-
-             //d = fabs((x0 - x1) x (x0 - x2))/fabs(x2 - x1)
-             distance = pointToLineDistance(ufo->pos,
-                                            wormhole->sectors[j-1].splinePoint,
-                                            wormhole->sectors[j].splinePoint);
-            if(wormhole->sectors[j-1].radius <= distance + ufo->radius)
-            {
-                collision += 1;
-            }
-        }
+        impactPos.x = from.x + impactTime*(ufo->pos.x - from.x);
+        impactPos.y = from.y + impactTime*(ufo->pos.y - from.y);
+        impactPos.z = from.z + impactTime*(ufo->pos.z - from.z);
+        collision += 1;
+        float x = progress(impactPos);
+        if(x * 10 > score)
+            score = (int) x * 10;
     }
 
     if(collision != 0)
@@ -776,12 +990,28 @@ void cGLWidget::checkCollisions()
  */
 void cGLWidget::setScore()
 {
-    if(ufo->pos.x * 10 > score)
+    float x = progress(ufo->pos);
+    if(x * 10 > score)
     {
-        score = (int) ufo->pos.x * 10;
+        score = (int) x * 10;
     }
 }
 
+/*!
+ * \brief How far point p got along the wormhole.
+ *
+ * Distance is interpolated between spline points of the sector of p, see
+ * cWormhole::splineDistance(). For wormhole going along x axis it is about x,
+ * winding wormhole may turn back, so x can not be used.
+ */
+float cGLWidget::progress(sPoint3 p)
+{
+    int j = sectorCursor.locate(wormhole, p);
+    float s = qBound(0.0f, wormhole->sectorParam(j, p), 1.0f);
+    float d0 = wormhole->splineDistance(j-1);
+    return d0 + s*(wormhole->splineDistance(j) - d0);
+}
+
 /*!
  * \brief Reset camera.
  *
@@ -806,23 +1036,20 @@ void cGLWidget::resetCamera(bool perspective)
     objXrot = objZrot = 0.0;
     objForward = 0.0;
 
-    glLoadIdentity();
-        if(perspective)
-        {
-            gluLookAt(ufo->pos.x - 5*ufo->radius,
-                      ufo->pos.y + 5*ufo->radius,
-                      ufo->pos.z + 5*ufo->radius,
-                      ufo->pos.x, ufo->pos.y, ufo->pos.z,
-                      0.0, 1.0, 0.0);
-        }
-        else
-        {
-            glTranslatef(0.0, 0.0, -(ufo->radius*12.0));
-            gluLookAt(camX, camY, camZ,
-                      ufo->pos.x, ufo->pos.y, ufo->pos.z,
-                      upX, upY, upZ);
-        }
-    glGetDoublev(GL_MODELVIEW_MATRIX, flmMatrix);
+    vec3 pos(ufo->pos.x, ufo->pos.y, ufo->pos.z);
+    if(perspective)
+    {
+        flmMatrix = mat4::LookAt(vec3(ufo->pos.x - 5*ufo->radius,
+                                      ufo->pos.y + 5*ufo->radius,
+                                      ufo->pos.z + 5*ufo->radius),
+                                 pos, vec3(0.0, 1.0, 0.0));
+    }
+    else
+    {
+        flmMatrix = mat4::Translation(0.0, 0.0, -(ufo->radius*12.0)) *
+                    mat4::LookAt(vec3(camX, camY, camZ), pos,
+                                 vec3(upX, upY, upZ));
+    }
 }
 
 /*!
@@ -841,10 +1068,11 @@ void cGLWidget::resetUfo()
 
     ufo->pos.x = ufo->pos.y = ufo->pos.z = 0.0;
     collision = 0;
+    sectorCursor.reset();
+    bLastUfoPos = false;
 
-    glLoadIdentity();
-    glRotatef(-90, 0.0, 1.0, 0.0);
-    glGetDoublev(GL_MODELVIEW_MATRIX, ssmMatrix);
+    ssmRotation = quat(-90, vec3(0.0, 1.0, 0.0));
+    ssmMatrix = mat4(ssmRotation, vec3());
 }
 
 //void cGLWidget::gameLoop()
@@ -937,27 +1165,28 @@ int cGLWidget::LoadTextureFromBMP(char *filename, GLuint texture_name)
  * If object coordinates pass through middle sector in wormhole, new sectors
  * are generated and appended. Old ones from beginning are removed. Number of
  * generated and removed sectors is quarter from number of control points.
+ *
+ * Generation starts in background one knot span before the middle sector
+ * (see cWormhole::startShift()). Once the object passes the middle sector,
+ * new sectors are taken over as soon as they are ready. Nothing here waits
+ * for the generation.
+ *
+ * Sector of the object is found by sectorCursor, winding wormhole does not go
+ * along x axis.
  */
 void cGLWidget::checkWormhole()
 {
-    if(ufo->pos.x > wormhole->sectors[wormhole->whSectors/2].splinePoint.x)
+    int middle = wormhole->whSectors/2;
+    int approach = qMax(middle - wormhole->sectorsPerSpan, 0);
+    int j = sectorCursor.locate(wormhole, ufo->pos);
+
+    if(!wormhole->isShifting() && j > approach)
+        wormhole->startShift(wormhole->nControlPoints/4);
+
+    if(j > middle && wormhole->finishShift())
     {
-        sPoint3 tmpPoint;
-        for(int i = 0; i < wormhole->nControlPoints/4; i++)
-        {
-            wormhole->listControlPoints.removeFirst();
-            tmpPoint.x = wormhole->listControlPoints.last().x + 1.0;
-            tmpPoint.y = (rand() % 2000 - 1000) / 1000.0;
-            tmpPoint.z = (rand() % 2000 - 1000) / 1000.0;
-            wormhole->listControlPoints.append(tmpPoint);
-
-            wormhole->listControlRadiusPoints.removeFirst();
-            tmpPoint.x = wormhole->listControlRadiusPoints.last().x + 1.0;
-            tmpPoint.y = (rand() % 400 + 200) / 1000.0;
-            tmpPoint.z = 0.0;
-            wormhole->listControlRadiusPoints.append(tmpPoint);
-        }
-        recreateWormhole();
+        makeCurrent();
+        wormhole->makeBuffers();
 //        lastPaintTime.restart();
     }
 }
@@ -965,26 +1194,32 @@ void cGLWidget::checkWormhole()
 /*!
  * \brief Method ensures proper recreation of a wormhole.
  *
- * First of all, wormhole data are updated, old display list is freed and new
- * one is created.
+ * First of all, wormhole data are updated and uploaded to vertex buffer.
+ * Changed shape of the wormhole (see cMainWindow::settings_winding) resets the
+ * game, ufo may be outside of the new wormhole.
  *
  * \note public slot
  */
 void cGLWidget::recreateWormhole()
 {
+    if(wormhole->bWinding != parentCWidget->settings_winding)
+    {
+        wormhole->bWinding = parentCWidget->settings_winding;
+        reset(); // recreates the wormhole again
+        return;
+    }
+
     wormhole->updateObject(wormhole->whSectors, wormhole->circleSectors);
     makeCurrent();
-    glDeleteLists(wormhole->object, wormhole->nLists);
-    wormhole->object =
-        wormhole->makeDisplayList(parentCWidget->settings_polygons);
+    wormhole->makeBuffers();
 //    updateGL();
 }
 
 /*!
  * \brief Recreation of a wormhole with new sectors specified.
  *
- * First of all, wormhole data are updated, old display list is freed and new
- * one is created. Solot manipulated from cMainWindow.
+ * First of all, wormhole data are updated and uploaded to vertex buffer.
+ * Solot manipulated from cMainWindow.
  *
  * \note public slot
  */
@@ -993,9 +1228,7 @@ void cGLWidget::setCircleSectors(int sectors)
     if (sectors >= 3 && 200 >= sectors) {
         wormhole->updateObject(wormhole->whSectors, sectors);
         makeCurrent();
-        glDeleteLists(wormhole->object, wormhole->nLists);
-        wormhole->object =
-            wormhole->makeDisplayList(parentCWidget->settings_polygons);
+        wormhole->makeBuffers();
         updateGL();
     }
 }
@@ -1003,20 +1236,23 @@ void cGLWidget::setCircleSectors(int sectors)
 /*!
  * \brief Recreation of a wormhole with new circle sectors specified.
  *
- * First of all, wormhole data are updated, old display list is freed and new
- * one is created. Solot manipulated from cMainWindow.
+ * First of all, wormhole data are updated and uploaded to vertex buffer.
+ * Solot manipulated from cMainWindow. Number of sectors is rounded to whole
+ * knot spans (see cWormhole::allocSectors()), whSectorsChanged() reports the
+ * rounded one back.
  *
  * \note public slot
  */
 void cGLWidget::setWhSectors(int sectors)
 {
-    if (sectors >= 20 && 400 >= sectors) {
+    if (sectors >= minWhSectors && maxWhSectors >= sectors &&
+        sectors != wormhole->whSectors) {
         wormhole->updateObject(sectors, wormhole->circleSectors);
         makeCurrent();
-        glDeleteLists(wormhole->object, wormhole->nLists);
-        wormhole->object =
-            wormhole->makeDisplayList(parentCWidget->settings_polygons);
+        wormhole->makeBuffers();
         updateGL();
+        if (wormhole->whSectors != sectors)
+            emit whSectorsChanged(wormhole->whSectors);
     }
 }
 
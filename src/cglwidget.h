@@ -11,6 +11,7 @@
 #define CGLWIDGET_H
 
 #include "myinclude.h"
+#include "csectorcursor.h"
 
 #include <QGLWidget>
 #include <QTimer>
@@ -20,6 +21,7 @@ class cMainWindow;
 class cGLObject;
 class cWormhole;
 class cUfo;
+class vec3;
 
 /*!
  * \class cGLWidget
@@ -55,9 +57,13 @@ public slots:
 
 private slots:
     void animate();
+    void checkLoading();
 
 signals:
     void circleSectorsChanged(int sectors);
+    void whSectorsChanged(int sectors);
+    void loadProgress(int percent);
+    void loadFinished();
 
 protected:
     void initializeGL();
@@ -80,12 +86,26 @@ protected:
     void moveObjects();
     void checkCollisions();
     void setScore();
-    float pointToLineDistance(sPoint3 point, sPoint3 A, sPoint3 B);
+    float sweepCollision(sPoint3 from, sPoint3 to, float shipRadius,
+                         bool bNarrowest);
+    float sectorImpact(int j, const vec3 &from, const vec3 &to, float room,
+                       float t0, float t1);
+    float hullCollision(sPoint3 from, sPoint3 to, float start);
+    float progress(sPoint3 p);
+    float ufoPixelRadius(double distance);
     void resetCamera(bool perspective = false);
     void resetUfo();
 
     int collision;
-    float distance;
+    cSectorCursor sectorCursor; // sector of ufo in the wormhole
+    sPoint3 lastUfoPos;   // ufo position in the previous collision check
+    bool bLastUfoPos;     // false after reset, lastUfoPos is not valid
+    float impactTime;     // part of the last step done before collision
+    sPoint3 impactPos;    // ufo position at the collision
+    QVector<float> hullX; // ufo hull points placed in the wormhole, see
+    QVector<float> hullY; // cGLWidget::hullCollision()
+    QVector<float> hullZ;
+    QVector<int> hullSectors; // sectors the hull may reach
     float score;
 
 private:
@@ -102,6 +122,7 @@ private:
     cGLObject *obj3;
     cWormhole *wormhole;
     cUfo *ufo;
+    cUfo *ufoLoading; // ship loaded in background, NULL when done
 
     int xRot;
     int yRot;
@@ -144,6 +165,8 @@ private:
     float piover180;
     QPoint lastPos;
     QTimer animationTimer;
+    QTimer loadTimer;
+    int lastLoadProgress;
 };
 
 
@@ -11,7 +11,9 @@
 
 #include "cmainwindow.h"
 #include "cglwidget.h"
+#include "cwormhole.h"
 #include "cdsettings.h"
+#include "cmeshcache.h"
 
 /*!
  * \brief Constructs the main window of the application.
@@ -29,6 +31,13 @@ cMainWindow::cMainWindow()
     settings = new QSettings();
     readSettings();
 
+    // ships offered in cDSettings are parsed in background and kept, chosen
+    // one first, it is held until cGLWidget's cUfo takes it over
+    chosenObject = cMeshCache::instance()->load(settings_object);
+    cMeshCache::instance()->preload(QString("small_ship.obj"));
+    cMeshCache::instance()->preload(QString("alien_ship.obj"));
+    cMeshCache::instance()->preload(QString("own_ship.obj"));
+
     glWidget_format = new QGLFormat();
     glWidget = NULL;
 
@@ -46,20 +55,6 @@ cMainWindow::cMainWindow()
     createToolBars();
     createStatusBar();
 
-    widget_progressBar = new QWidget;
-    progressbar_glWidget = new QProgressBar;
-    label_progressbar = new QLabel;
-    vboxlayout_glWidget = new QVBoxLayout;
-    label_progressbar->setText(QString("Loading..."));
-    label_progressbar->setAlignment(Qt::AlignHCenter | Qt::AlignBottom);
-    vboxlayout_glWidget->addStretch();
-    vboxlayout_glWidget->addWidget(label_progressbar);
-    vboxlayout_glWidget->addWidget(progressbar_glWidget);
-    vboxlayout_glWidget->addStretch();
-    progressbar_glWidget->setValue(0);
-    widget_progressBar->setLayout(vboxlayout_glWidget);
-    setCentralWidget(widget_progressBar);
-
     createNonGLWidgetConnections(); // except connections to glWidgets
 
     QTimer::singleShot(100, this, SLOT(reCreateGLWidget()));
@@ -226,6 +221,13 @@ void cMainWindow::createStatusBar()
                                  QString().number(settings_bestscore, 10) +
                                  QString(" "));
     statusBar()->addPermanentWidget(label_bestscore);
+
+    // ship loading progress, shown only while loading
+    progressbar_glWidget = new QProgressBar;
+    progressbar_glWidget->setRange(0, 100);
+    progressbar_glWidget->setMaximumWidth(150);
+    progressbar_glWidget->hide();
+    statusBar()->addPermanentWidget(progressbar_glWidget);
 }
 
 /*!
@@ -255,6 +257,8 @@ void cMainWindow::writeSettings()
 
     settings->beginGroup("Difficulty");
         settings->setValue("navigation",  settings_navigation);
+        settings->setValue("hullCollision",  settings_hullCollision);
+        settings->setValue("winding",  settings_winding);
         settings->setValue("difficulty",  settings_difficulty);
     settings->endGroup();
 
@@ -298,6 +302,8 @@ void cMainWindow::readSettings()
 
     settings->beginGroup("Difficulty");
         settings_navigation = settings->value("navigation", true).toBool();
+        settings_hullCollision = settings->value("hullCollision", false).toBool();
+        settings_winding = settings->value("winding", false).toBool();
         settings_difficulty = settings->value("difficulty", QString("Easy")).toString();
     settings->endGroup();
 
@@ -357,8 +363,8 @@ QSlider *cMainWindow::createCircleSectorsSlider()
  * to have special format of QGLWidget window and this format must be specified
  * before creation of such widget. So in order to support turning multisample
  * technique on and off, the recreation of glWidget is needed.
- * Furthermore while parsing an object in glWidget constructor a progressbar is
- * shown.
+ * New glWidget is shown right away, it loads its ship in background and
+ * reports progress to the statusbar.
  */
 void cMainWindow::reCreateGLWidget()
 {
@@ -380,34 +386,10 @@ void cMainWindow::reCreateGLWidget()
     {
         glWidget->close();
         delete glWidget;
-
-        widget_progressBar = new QWidget;
-        progressbar_glWidget = new QProgressBar;
-        label_progressbar = new QLabel;
-        vboxlayout_glWidget = new QVBoxLayout;
-        label_progressbar->setText(QString("Loading..."));
-        label_progressbar->setAlignment(Qt::AlignHCenter | Qt::AlignBottom);
-        vboxlayout_glWidget->addStretch();
-        vboxlayout_glWidget->addWidget(label_progressbar);
-        vboxlayout_glWidget->addWidget(progressbar_glWidget);
-        vboxlayout_glWidget->addStretch();
-        progressbar_glWidget->setValue(0);
-        widget_progressBar->setLayout(vboxlayout_glWidget);
-        setCentralWidget(widget_progressBar);
-
-        qApp->processEvents();
     }
 
-    this->setDisabled(true);
     glWidget = new cGLWidget(*glWidget_format, this);
-    this->setDisabled(false);
-
-    label_progressbar->close();
-    delete label_progressbar;
-    progressbar_glWidget->close();
-    delete progressbar_glWidget;
-    delete vboxlayout_glWidget;
-    delete widget_progressBar;
+    chosenObject.clear(); // held by glWidget's cUfo now
 
     createGLWidgetConnections();
     setCentralWidget(glWidget);
@@ -431,6 +413,10 @@ void cMainWindow::createGLWidgetConnections()
             glWidget, SLOT(setCircleSectors(int)));
     connect(whSectorsSlider, SIGNAL(valueChanged(int)),\
             glWidget, SLOT(setWhSectors(int)));
+    connect(glWidget, SIGNAL(whSectorsChanged(int)),
+            whSectorsSlider, SLOT(setValue(int)));
+    // new glWidget starts with its own (rounded) number of sectors
+    whSectorsSlider->setValue(glWidget->wormhole->whSectors);
     connect(polygonModeComboBox, SIGNAL(currentIndexChanged(const QString &)),\
             glWidget, SLOT(setPolygonMode(QString)));
 
@@ -439,6 +425,36 @@ void cMainWindow::createGLWidgetConnections()
     
     connect(fullscreenAction, SIGNAL(triggered()),
             glWidget, SLOT(toggleFullScreen()));
+
+    connect(glWidget, SIGNAL(loadProgress(int)),
+            this, SLOT(showLoadProgress(int)));
+    connect(glWidget, SIGNAL(loadFinished()), this, SLOT(hideLoadProgress()));
+}
+
+/*!
+ * \brief Shows progress of ship loading in the statusbar.
+ *
+ * \note private slot
+ */
+void cMainWindow::showLoadProgress(int percent)
+{
+    if(!progressbar_glWidget->isVisible())
+    {
+        statusBar()->showMessage(tr("Loading ") + settings_object);
+        progressbar_glWidget->show();
+    }
+    progressbar_glWidget->setValue(percent);
+}
+
+/*!
+ * \brief Hides progress of ship loading, the ship is ready.
+ *
+ * \note private slot
+ */
+void cMainWindow::hideLoadProgress()
+{
+    progressbar_glWidget->hide();
+    statusBar()->showMessage(tr("Ready"));
 }
 
 /*!
@@ -12,6 +12,7 @@
 
 
 #include <QMainWindow>
+#include <QSharedPointer>
 
 class cGLWidget;
 class QGLFormat;
@@ -29,6 +30,7 @@ class QToolBar;
 class QMenu;
 
 class cDSettings;
+class cObj2OGL;
 
 /*!
  * \class cMainWindow
@@ -58,10 +60,8 @@ public:
     Qt::WindowStates stateCWidget;
     int screenNum;
 
-    // object parsing progress bar
+    // object parsing progress bar (in statusbar)
     QProgressBar * progressbar_glWidget;
-    QVBoxLayout * vboxlayout_glWidget;
-    QLabel * label_progressbar;
 
     // statusbar widgets
     QLabel * label_bestscore;
@@ -76,6 +76,8 @@ public:
     int settings_multisampling;
     bool settings_recreateGL;
     bool settings_navigation;
+    bool settings_hullCollision;
+    bool settings_winding;
     QString settings_difficulty;
     QString settings_object;
     int settings_polygons;
@@ -89,6 +91,8 @@ public slots:
 
 private slots:
     void reCreateGLWidget();
+    void showLoadProgress(int percent);
+    void hideLoadProgress();
     void about();
     void aboutOpenGL();
     void help();
@@ -110,13 +114,14 @@ private:
     cGLWidget * glWidget;
     cDSettings * dialog_settings;
 
+    // chosen ship loaded in background, held until first glWidget's cUfo
+    QSharedPointer<cObj2OGL> chosenObject;
+
     QSlider * circleSectorsSlider;
     QSlider * whSectorsSlider;
 
     QComboBox * polygonModeComboBox;
 
-    QWidget * widget_progressBar;
-
     QMenu * gameMenu;
     QMenu * settingsMenu;
     QMenu * helpMenu;
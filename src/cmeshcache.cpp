@@ -0,0 +1,127 @@
+/*!
+ * \file cmeshcache.cpp
+ *
+ * \author David Smejkal
+ * \date 17.10.2026
+ *
+ * Process-wide cache of parsed meshes definition.
+ */
+
+#include "cmeshcache.h"
+
+#include <QFileInfo>
+#include <QtConcurrentRun>
+
+/*!
+ * \brief Parses obj file into mesh and builds its vertex and index arrays.
+ *
+ * Runs in the global thread pool. No GL calls are made. Statistics of the
+ * mesh are printed if WH_STATS is defined. Mesh is held until it is loaded,
+ * even if everybody else lets it go.
+ */
+static void loadMesh(QSharedPointer<cObj2OGL> mesh, QString path)
+{
+    mesh->makeObjectFromObjFileWithNormals(path, NULL, NULL);
+    mesh->buildMesh();
+#ifdef WH_STATS
+    mesh->printStats();
+#endif
+}
+
+/*!
+ * \brief Constructor of cMeshCache.
+ */
+cMeshCache::cMeshCache()
+{
+}
+
+/*!
+ * \brief Destructor of cMeshCache.
+ *
+ * Waits for meshes still being loaded, so the thread pool is idle when the
+ * application quits.
+ */
+cMeshCache::~cMeshCache()
+{
+    QHash<QString, sEntry>::iterator it;
+    for(it = entries.begin(); it != entries.end(); ++it)
+        it.value().loading.waitForFinished();
+}
+
+/*!
+ * \brief The only cMeshCache of the application.
+ */
+cMeshCache *cMeshCache::instance()
+{
+    static cMeshCache cache;
+    return &cache;
+}
+
+/*!
+ * \brief Same obj file reached by different paths shares one entry.
+ */
+QString cMeshCache::key(QString path)
+{
+    return QFileInfo(path).absoluteFilePath();
+}
+
+/*!
+ * \brief Returns mesh of obj file, starts loading it if it is not cached.
+ *
+ * Returned cObj2OGL must not be used before cMeshCache::isLoading() turns
+ * false (or after cMeshCache::waitForLoading()), except for its progress.
+ * Mesh that was freed by its last holder is loaded again. Never blocks, a
+ * mesh is held by loadMesh() while it is loaded, so it is not freed before.
+ */
+QSharedPointer<cObj2OGL> cMeshCache::load(QString path)
+{
+    QString k = key(path);
+
+    QHash<QString, sEntry>::iterator it = entries.find(k);
+    if(it != entries.end())
+    {
+        QSharedPointer<cObj2OGL> mesh = it.value().mesh.toStrongRef();
+        if(!mesh.isNull())
+            return mesh;
+    }
+
+    QSharedPointer<cObj2OGL> mesh(new cObj2OGL());
+    sEntry &entry = entries[k];
+    entry.mesh = mesh;
+    entry.pinned.clear();
+    entry.loading = QtConcurrent::run(loadMesh, mesh, path);
+
+    return mesh;
+}
+
+/*!
+ * \brief Starts loading obj file in background, so later load() finds it.
+ *
+ * Preloaded mesh is kept for the whole run, even when no cUfo holds it.
+ */
+void cMeshCache::preload(QString path)
+{
+    entries[key(path)].pinned = load(path);
+}
+
+/*!
+ * \brief Whether mesh of obj file is still being loaded.
+ */
+bool cMeshCache::isLoading(QString path) const
+{
+    QHash<QString, sEntry>::const_iterator it = entries.find(key(path));
+    if(it == entries.end()) return false;
+
+    return !it.value().loading.isFinished();
+}
+
+/*!
+ * \brief Blocks until mesh of obj file is loaded.
+ */
+void cMeshCache::waitForLoading(QString path)
+{
+    QHash<QString, sEntry>::iterator it = entries.find(key(path));
+    if(it == entries.end()) return;
+
+    it.value().loading.waitForFinished();
+}
@@ -0,0 +1,65 @@
+/*!
+ * \file cmeshcache.h
+ *
+ * \author David Smejkal
+ * \date 17.10.2026
+ *
+ * Process-wide cache of parsed meshes declaration.
+ */
+
+#ifndef CMESHCACHE_H
+#define CMESHCACHE_H
+
+#include "cobj2ogl.h"
+
+#include <QHash>
+#include <QString>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include <QFuture>
+
+/*!
+ * \class cMeshCache
+ * \brief Parsed meshes shared by every cUfo, keyed by obj file path.
+ *
+ * Meshes are parsed and built in the global thread pool. Preloaded meshes are
+ * kept for the whole run of the application, so recreating cGLWidget or
+ * switching ships in cDSettings does not parse anything again. Other meshes
+ * are handed out as refcounted cObj2OGL and freed with their last holder,
+ * the cache only keeps a weak reference to them.
+ * Not to be confused with the binary cache file of cObj2OGL, which survives
+ * between runs.
+ *
+ * Only to be used from the GUI thread.
+ */
+class cMeshCache
+{
+public:
+    static cMeshCache *instance();
+
+    QSharedPointer<cObj2OGL> load(QString path);
+    void preload(QString path);
+    bool isLoading(QString path) const;
+    void waitForLoading(QString path);
+
+private:
+    cMeshCache();
+    ~cMeshCache();
+
+    static QString key(QString path);
+
+    /*!
+     * \brief One cached mesh and its background loading.
+     */
+    struct sEntry
+    {
+        QWeakPointer<cObj2OGL> mesh;
+        QSharedPointer<cObj2OGL> pinned; // preloaded mesh, kept for the run
+        QFuture<void> loading;
+    };
+
+    QHash<QString, sEntry> entries;
+};
+
+
+#endif // CMESHCACHE_H
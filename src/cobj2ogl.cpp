@@ -12,25 +12,53 @@
 #include "cobj2ogl.h"
 
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 
 #include <QtGui>
 #include <QProgressDialog>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QCryptographicHash>
+#include <QFileInfo>
 
 /*!
- * \brief Just NULLing some pointers in constructor of cObj2OGL.
+ * \brief Just zeroing counters in constructor of cObj2OGL.
  *
- * Pointers needs to be NULLed. This needs to be done in order to prevent
- * deleting untaken memory since deleting of these pointers will be done in some
- * other methods of this class (NULL pointers don't get freed in C++, even if
- * delete is explicitly called on them).
+ * Parsed data are held in vectors that start empty, the counters need to
+ * match them.
  */
 cObj2OGL::cObj2OGL()
 {
-    vertices = NULL;
-    textures = NULL;
-    normals = NULL;
-    faces = NULL;
+    bOptimizeMesh = true;
+    bBuildLods = true;
+    normalWeighting = AngleWeighting;
+    bPackVertices = true;
+    acmrBefore = 0.0;
+    acmrAfter = 0.0;
+    lodEdges = 0;
+    lodOpenEdges = 0;
+    vertexBytesBefore = 0;
+    vertexBytesAfter = 0;
+    indexBytesBefore = 0;
+    indexBytesAfter = 0;
+    bytesPerFace = 0.0;
+    numVertices = 0;
+    numTextures = 0;
+    numNormals = 0;
+    numFaces = 0;
+    faceOffsets.append(0);
     bParsed = false;
+    bMeshCached = false;
+    progress = 0;
+    meshVertexData = NULL;
+    meshPackedData = NULL;
+    meshIndexData = NULL;
+    nMeshVertices = 0;
+    nMeshIndices = 0;
+    meshMin.x = meshMin.y = meshMin.z = 0.0;
+    meshMax.x = meshMax.y = meshMax.z = 0.0;
+    meshCacheMap = NULL;
 }
 
 /*!
@@ -46,113 +74,500 @@ cObj2OGL::~cObj2OGL()
 }
 
 /*!
- * \brief Free some fields of allocated memory.
+ * \brief Free parsed data.
  *
  * This is the method called from destructor and several other places in this
- * class. This method just free some fields of allocated memory. Notice that
- * delete [] is used since we want to free a field of allocated memory, not just
- * one variable.
+ * class. Vectors of parsed data are cleared and the counters zeroed, mapped
+ * mesh cache is closed.
  */
 void cObj2OGL::freeMemory()
 {
-    delete [] vertices;
-    delete [] textures;
-    delete [] normals;
-    delete [] faces;
+    closeMeshCache();
+
+    vertices.clear();
+    textures.clear();
+    normals.clear();
+    faceCorners.clear();
+    faceOffsets.clear();
+    faceOffsets.append(0);
+    numVertices = 0;
+    numTextures = 0;
+    numNormals = 0;
+    numFaces = 0;
+}
+
+// bytes of obj file mapped at once when the whole file can not be mapped
+static const qint64 objMapWindow = 64*1024*1024;
+
+// blank characters separating tokens of an obj line
+static inline bool isObjBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// true if the line at p starts with keyword followed by white space
+static inline bool isObjKeyword(const char *p, const char *end,
+                                const char *keyword, int length)
+{
+    if(end - p <= length || memcmp(p, keyword, length) != 0) return false;
+    return isObjBlank(p[length]) || p[length] == '\n';
 }
 
 /*!
- * \brief Creates display list from obj file specified by str parameter.
+ * \brief Finds next token of the line.
  *
- * Parsing obj file without normals. So vertex normals will be calculated and
- * ofcourse normalized.
+ * Skips blanks from p, the token is [token, p) afterwards.
  *
- * \return ID of compiled display list.
- * \sa cObj2OGL::makeObjectFromObjFileWithNormals()
+ * \return false if there is no token left before eol.
  */
-int cObj2OGL::makeObjectFromObjFile(QString str)
+static inline bool nextObjToken(const char *&p, const char *eol,
+                                const char *&token)
 {
-    QFile objFile(str);
-    if(!objFile.exists()) return 0;
+    while(p < eol && isObjBlank(*p)) p++;
+    if(p == eol) return false;
+    token = p;
+    while(p < eol && !isObjBlank(*p)) p++;
+    return true;
+}
 
-    /* First pass - Count vertices and faces. */
-    if(!objFile.open(QIODevice::ReadOnly)) return 0;
+/*!
+ * \brief Parses integer in [p, end).
+ *
+ * Same results as QString::toInt(), anything else than a whole integer
+ * gives 0.
+ */
+static int parseObjInt(const char *p, const char *end)
+{
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+'))
+        negative = (*p++ == '-');
+    if(p == end) return 0;
 
-    // its important to zero these before while loop
-    numVertices = 0; 
-    numNormals = 0;
-    numFaces = 0;
-    QRegExp regV("^v\\s.*");
-    QRegExp regF("^f\\s.*");
-    QString line;
-    while (!objFile.atEnd())
+    qint64 value = 0;
+    for(; p < end; p++)
     {
-        line = objFile.readLine();
-        if(line.contains(regV)) numVertices++;
-        else if(line.contains(regF)) numFaces++;
+        if(*p < '0' || *p > '9') return 0;
+        value = 10*value + (*p - '0');
+        if(value > 2147483648LL) return 0;
     }
+    if(negative) value = -value;
+    if(value > 2147483647LL) return 0;
+    return (int) value;
+}
 
-    objFile.close();
-
-    /* Second pass - Now when numbers of vertices and faces are known create
-       arrays and feed them with values from object file.*/
-    if(!objFile.open(QIODevice::ReadOnly)) return 0;
+/*!
+ * \brief Parses float in [p, end).
+ *
+ * Decimal numbers with at most 19 significant digits and a small exponent
+ * are converted exactly (the mantissa and the power of ten are both exact
+ * doubles). Everything else goes through QByteArray::toFloat(), so results
+ * are the same as of QString::toFloat().
+ */
+static float parseObjFloat(const char *p, const char *end)
+{
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
 
-    vertices = new sPoint3[numVertices];
-    normals = new sPoint3[numVertices];
-    faces = new QList<sFace>[numFaces];
+    const char *s = p;
+    bool negative = false;
+    if(s < end && (*s == '-' || *s == '+'))
+        negative = (*s++ == '-');
 
-    for(int i=0; i < numVertices; i++)
+    quint64 mantissa = 0;
+    int digits = 0;     // significant digits in mantissa
+    int exponent = 0;
+    bool bDigits = false;
+    for(; s < end && *s >= '0' && *s <= '9'; s++)
+    {
+        mantissa = 10*mantissa + (*s - '0');
+        if(mantissa != 0) digits++;
+        bDigits = true;
+    }
+    if(s < end && *s == '.')
+    {
+        for(s++; s < end && *s >= '0' && *s <= '9'; s++)
+        {
+            mantissa = 10*mantissa + (*s - '0');
+            if(mantissa != 0) digits++;
+            exponent--;
+            bDigits = true;
+        }
+    }
+    if(bDigits && s < end && (*s == 'e' || *s == 'E'))
     {
-        normals[i].x = 0.0;
-        normals[i].y = 0.0;
-        normals[i].z = 0.0;
+        s++;
+        bool negativeExp = false;
+        if(s < end && (*s == '-' || *s == '+'))
+            negativeExp = (*s++ == '-');
+        int exp = 0;
+        bool bExpDigits = false;
+        for(; s < end && *s >= '0' && *s <= '9' && exp < 1000; s++)
+        {
+            exp = 10*exp + (*s - '0');
+            bExpDigits = true;
+        }
+        if(!bExpDigits) bDigits = false;
+        exponent += negativeExp ? -exp : exp;
     }
 
-    int i = 0;
-    int j = 0;
-    QStringList tempLineSegments;
-    QStringList tempFaceSegments;
-    sPoint3 tempPoint;
-    sFace tempFace;
-    while(i < numVertices || j < numFaces)
+    if(!bDigits || s != end || digits > 19 ||
+       mantissa > (Q_UINT64_C(1) << 53) || exponent < -22 || exponent > 22)
+        return QByteArray(p, end - p).toFloat();
+
+    double value = (double) mantissa;
+    if(exponent < 0)
+        value /= powers[-exponent];
+    else
+        value *= powers[exponent];
+    return (float) (negative ? -value : value);
+}
+
+/*!
+ * \brief Parses up to max floats following the keyword of the line.
+ *
+ * \return Number of floats found.
+ */
+static int parseObjFloats(const char *p, const char *eol, float *out, int max)
+{
+    const char *token;
+    nextObjToken(p, eol, token); // keyword
+    int n = 0;
+    while(n < max && nextObjToken(p, eol, token))
+        out[n++] = parseObjFloat(token, p);
+    return n;
+}
+
+// smallest part of obj file worth parsing in its own thread
+static const qint64 objChunkMin = 256*1024;
+
+/*!
+ * \brief Part of obj file parsed by one thread.
+ *
+ * Parsed data of the part are kept apart until all preceding parts are done,
+ * see cObj2OGL::parseObjParallel().
+ */
+struct sObjChunk {
+    const char *data;
+    qint64 size;
+    QVector<sPoint3> vertices;
+    QVector<sPoint3> textures;
+    QVector<sPoint3> normals;
+    QVector<sFace> faceCorners;
+    QVector<int> faceEnds;  // end of every face in faceCorners
+    // corner and field (0 vertex, 1 texture, 2 normal) of every index given
+    // relative to the end of the list, it counts from the chunk start
+    QVector<int> relative;
+};
+
+/*!
+ * \brief Converts obj index to index counted from 0.
+ *
+ * Positive indices count from 1, negative ones count back from count
+ * elements read so far (-1 is the last one). Those are marked relative to
+ * the chunk they are in.
+ */
+static inline int objIndex(sObjChunk *chunk, int index, int count, int field)
+{
+    if(index >= 0) return index - 1;
+
+    chunk->relative.append(chunk->faceCorners.size());
+    chunk->relative.append(field);
+    return count + index;
+}
+
+/*!
+ * \brief Parses chunk of obj data in memory.
+ *
+ * One pass over the bytes, lines are classified by their keyword and numbers
+ * are parsed straight from the buffer. The chunk has to hold complete lines.
+ *
+ * Without bWithNormals only v and f lines are read and every face corner
+ * refers to the normal of its vertex.
+ */
+static void parseObjChunk(sObjChunk *chunk, bool bWithNormals)
+{
+    const char *p = chunk->data;
+    const char *end = chunk->data + chunk->size;
+
+    sPoint3 point;
+    float values[3];
+    sFace corner;
+    const char *token;
+    while(p < end)
     {
-        line = objFile.readLine();
-        if(line.contains(regV))
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        if(eol == NULL) eol = end;
+
+        if(isObjKeyword(p, end, "v", 1))
+        {
+            if(parseObjFloats(p, eol, values, 3) == 3)
+            {
+                point.x = values[0];
+                point.y = values[1];
+                point.z = values[2];
+            } else
+            {
+                point.x = 0.0;
+                point.y = 0.0;
+                point.z = 0.0;
+            }
+            chunk->vertices.append(point);
+        } else
+        if(bWithNormals && isObjKeyword(p, end, "vt", 2))
         {
-            tempLineSegments = line.split(" ");
-            vertices[i].x = tempLineSegments.at(1).toFloat();
-            vertices[i].y = tempLineSegments.at(2).toFloat();
-            vertices[i].z = tempLineSegments.at(3).toFloat();
-            i++;
-        } else if(line.contains(regF))
+            int n = parseObjFloats(p, eol, values, 3);
+            point.x = (n > 1) ? values[0] : 0.0;
+            point.y = (n > 1) ? values[1] : 0.0;
+            point.z = (n > 2) ? values[2] : 0.0;
+            chunk->textures.append(point);
+        } else
+        if(bWithNormals && isObjKeyword(p, end, "vn", 2))
         {
-            tempLineSegments = line.split(" ");
-            for(int k = 1; k < tempLineSegments.size(); k++)
+            if(parseObjFloats(p, eol, values, 3) == 3)
             {
-                tempFaceSegments = tempLineSegments.at(k).split("/");
-                tempFace.vertIndex = tempFaceSegments.at(0).toInt()-1;
-                tempFace.normIndex = tempFaceSegments.at(0).toInt()-1;
-                faces[j].append(tempFace);
-
+                point.x = values[0];
+                point.y = values[1];
+                point.z = values[2];
+            } else
+            {
+                point.x = 1.0;
+                point.y = 0.0;
+                point.z = 0.0;
             }
-            tempPoint = computeFaceNormal(faces[j].at(0).vertIndex, \
-                                          faces[j].at(1).vertIndex, \
-                                          faces[j].at(2).vertIndex);
-            for(int k = 0; k < faces[j].size(); k++)
+            chunk->normals.append(point);
+        } else
+        if(isObjKeyword(p, end, "f", 1))
+        {
+            const char *q = p + 1;
+            while(nextObjToken(q, eol, token))
+            {
+                // corner is vertex/texture/normal, missing index is -1
+                const char *slash1 =
+                    (const char *) memchr(token, '/', q - token);
+                const char *slash2 = (slash1 == NULL) ? NULL :
+                    (const char *) memchr(slash1 + 1, '/', q - slash1 - 1);
+                if(!bWithNormals)
+                {
+                    const char *vertEnd = (slash1 == NULL) ? q : slash1;
+                    int vert = parseObjInt(token, vertEnd);
+                    corner.vertIndex = objIndex(chunk, vert,
+                                                chunk->vertices.size(), 0);
+                    corner.textIndex = -1;
+                    corner.normIndex = corner.vertIndex;
+                } else
+                if(slash2 != NULL &&
+                   memchr(slash2 + 1, '/', q - slash2 - 1) == NULL)
+                {
+                    int vert = parseObjInt(token, slash1);
+                    int text = parseObjInt(slash1 + 1, slash2);
+                    int norm = parseObjInt(slash2 + 1, q);
+                    corner.vertIndex = objIndex(chunk, vert,
+                                                chunk->vertices.size(), 0);
+                    corner.textIndex = objIndex(chunk, text,
+                                                chunk->textures.size(), 1);
+                    corner.normIndex = objIndex(chunk, norm,
+                                                chunk->normals.size(), 2);
+                } else
+                {
+                    corner.vertIndex = 0;
+                    corner.textIndex = 0;
+                    corner.normIndex = 0;
+                }
+                chunk->faceCorners.append(corner);
+            }
+            chunk->faceEnds.append(chunk->faceCorners.size());
+        }
+
+        p = eol + 1;
+    }
+}
+
+/*!
+ * \brief Parses obj data in memory by several threads.
+ *
+ * Data are split at line ends to chunks of at least objChunkMin bytes, a few
+ * chunks per core. Chunks are parsed by the global thread pool and this
+ * thread, then appended to parsed data in file order. Vertices, texture
+ * coordinates and normals of preceding chunks are a prefix sum of their
+ * sizes, relative indices of every chunk are moved by it. Data are a part of
+ * a file of total bytes starting at offset, that is used for progress. It
+ * goes to progress and to progress_bar, if there is one.
+ */
+void cObj2OGL::parseObjParallel(const char *data, qint64 size,
+                                bool bWithNormals,
+                                QProgressBar * progress_bar,
+                                qint64 offset, qint64 total)
+{
+    int nChunks = (int) qMin(size/objChunkMin + 1,
+                             (qint64) 4*QThread::idealThreadCount());
+    if(nChunks < 1) nChunks = 1;
+
+    QVector<sObjChunk> chunks(nChunks);
+    const char *p = data;
+    const char *end = data + size;
+    for(int i = 0; i < nChunks; i++)
+    {
+        const char *chunkEnd = data + size*(i+1)/nChunks;
+        if(chunkEnd < p) chunkEnd = p;
+        const char *eol = (const char *) memchr(chunkEnd, '\n',
+                                                end - chunkEnd);
+        chunkEnd = (eol == NULL) ? end : eol + 1;
+
+        chunks[i].data = p;
+        chunks[i].size = chunkEnd - p;
+        p = chunkEnd;
+    }
+
+    QList< QFuture<void> > futures;
+    for(int i = 1; i < nChunks; i++)
+        futures.append(QtConcurrent::run(parseObjChunk, chunks.data() + i,
+                                         bWithNormals));
+    parseObjChunk(chunks.data(), bWithNormals);
+
+    for(int i = 0; i < nChunks; i++)
+    {
+        if(i > 0)
+            futures[i-1].waitForFinished();
+
+        sObjChunk &chunk = chunks[i];
+        int firstVertex = vertices.size();
+        int firstTexture = textures.size();
+        int firstNormal = normals.size();
+        int firstCorner = faceCorners.size();
+        vertices += chunk.vertices;
+        textures += chunk.textures;
+        normals += chunk.normals;
+        faceCorners += chunk.faceCorners;
+        for(int f = 0; f < chunk.faceEnds.size(); f++)
+            faceOffsets.append(firstCorner + chunk.faceEnds.at(f));
+
+        for(int r = 0; r < chunk.relative.size(); r += 2)
+        {
+            sFace &corner = faceCorners[firstCorner + chunk.relative.at(r)];
+            switch(chunk.relative.at(r+1))
             {
-                normals[faces[j].at(k).vertIndex].x += tempPoint.x;
-                normals[faces[j].at(k).vertIndex].y += tempPoint.y;
-                normals[faces[j].at(k).vertIndex].z += tempPoint.z;
+            case 0:
+                corner.vertIndex += firstVertex;
+                if(!bWithNormals)
+                    corner.normIndex = corner.vertIndex;
+                break;
+            case 1:
+                corner.textIndex += firstTexture;
+                break;
+            case 2:
+                corner.normIndex += firstNormal;
+                break;
             }
+        }
+
+        chunk.vertices.clear();
+        chunk.textures.clear();
+        chunk.normals.clear();
+        chunk.faceCorners.clear();
+        chunk.faceEnds.clear();
+
+        progress = (offset + (chunk.data - data) + chunk.size)*100/(total + 1);
+        if(progress_bar != NULL)
+            progress_bar->setValue(progress);
+    }
+}
+
+/*!
+ * \brief Parses obj file in place.
+ *
+ * The file is mapped to memory and tokenized right in the mapped bytes. When
+ * it can not be mapped at once (there is not enough address space for it),
+ * windows of objMapWindow bytes are mapped one after another. Every window is
+ * parsed up to its last complete line and the next window starts right after
+ * it, a line longer than the window doubles the window. Files that can not be
+ * mapped at all are read by the same windows.
+ *
+ * \return false if the file can not be read.
+ */
+bool cObj2OGL::parseObjFile(QString str, bool bWithNormals,
+                            QProgressBar * progress_bar)
+{
+    QFile objFile(str);
+    if(!objFile.exists()) return false;
+    if(!objFile.open(QIODevice::ReadOnly)) return false;
+
+    freeMemory();
 
-            j++;
+    qint64 size = objFile.size();
+    progress = 0;
+    if(progress_bar != NULL)
+        progress_bar->setRange(0, 100);
+
+    qint64 offset = 0;
+    qint64 window = size;
+    QByteArray buffer;
+    while(offset < size)
+    {
+        qint64 length = qMin(window, size - offset);
+        const char *chunk = (const char *) objFile.map(offset, length);
+        bool bMapped = (chunk != NULL);
+        if(!bMapped && window == size && size > objMapWindow)
+        {
+            window = objMapWindow;
+            continue;
         }
+        if(!bMapped)
+        {
+            objFile.seek(offset);
+            buffer = objFile.read(length);
+            if(buffer.size() != length) return false;
+            chunk = buffer.constData();
+        }
+
+        // the rest of the last line goes to the next window
+        qint64 used = length;
+        if(offset + length < size)
+            while(used > 0 && chunk[used-1] != '\n') used--;
+
+        if(used > 0)
+            parseObjParallel(chunk, used, bWithNormals, progress_bar,
+                             offset, size);
+        else
+            window *= 2;
+
+        if(bMapped)
+            objFile.unmap((uchar *) chunk);
+        offset += used;
     }
 
     objFile.close();
 
-    normalizeVertexNormals();
+    numVertices = vertices.size();
+    numTextures = textures.size();
+    numNormals = normals.size();
+    numFaces = faceOffsets.size() - 1;
+
+    progress = 100;
+    if(progress_bar != NULL)
+        progress_bar->setValue(100);
+
+    qint64 faceBytes = (qint64) faceCorners.capacity()*sizeof(sFace) +
+                       (qint64) faceOffsets.capacity()*sizeof(int);
+    bytesPerFace = numFaces > 0 ? faceBytes/(float) numFaces : 0.0;
+
+    return true;
+}
+
+/*!
+ * \brief Parses obj file specified by str parameter.
+ *
+ * Parsing obj file without normals. So vertex normals will be calculated by
+ * cObj2OGL::generateNormals() when the mesh is built, and ofcourse normalized.
+ *
+ * \return 1 on success, 0 if the file can not be read.
+ * \sa cObj2OGL::makeObjectFromObjFileWithNormals()
+ */
+int cObj2OGL::makeObjectFromObjFile(QString str)
+{
+    objFileName.clear();
+    if(!parseObjFile(str, false, NULL)) return 0;
 
     bParsed = true;
 
@@ -160,287 +575,1582 @@ int cObj2OGL::makeObjectFromObjFile(QString str)
 }
 
 /*!
- * \brief Creates display list from obj file specified by str parameter.
+ * \brief Parses obj file specified by str parameter.
  *
  * Parsing obj file with normals. No vertex normals will get calculated this
  * time. Trusted ones from obj file will be used instead.
  *
- * \return ID of compiled display list.
+ * When the obj file has a valid mesh cache, nothing is parsed and the mesh is
+ * mapped from the cache instead, see cObj2OGL::loadMeshCache().
+ *
+ * Parsing may run in a worker thread, progress (0 - 100) can be read from
+ * any thread meanwhile. Widgets must be NULL then.
+ *
+ * \return 1 on success, 0 if the file can not be read.
  * \sa cObj2OGL::makeObjectFromObjFile()
  */
 int cObj2OGL::makeObjectFromObjFileWithNormals(QString str,
                                                QProgressBar * progress_bar,
                                                QLabel * progress_label)
 {
-    QFile objFile(str);
-    if(!objFile.exists()) return 0;
-
-    /* First pass - Count vertices and faces. */
-    if(!objFile.open(QIODevice::ReadOnly)) return 0;
+    if(progress_label != NULL)
+    {
+        progress_label->setText(str);
+        progress_label->repaint();
+    }
 
-    // its important to zero these before while loop
-    numVertices = 0;
-    numTextures = 0;
-    numNormals = 0;
-    numFaces = 0;
-    QRegExp regV("^v\\s.*");
-    QRegExp regT("^vt\\s.*");
-    QRegExp regN("^vn\\s.*");
-    QRegExp regF("^f\\s.*");
-    QString line;
-    while (!objFile.atEnd())
+    objFileName = str;
+    if(loadMeshCache(str))
     {
-        line = objFile.readLine();
-        if(line.contains(regV)) numVertices++;
-        else if(line.contains(regT)) numTextures++;
-            else if(line.contains(regN)) numNormals++;
-                else if(line.contains(regF)) numFaces++;
+        progress = 100;
+        bParsed = true;
+        return 1;
     }
 
-    objFile.close();
+    if(!parseObjFile(str, true, progress_bar)) return 0;
 
-    /* Second pass - Now when numbers of vertices and faces are known create
-       arrays and feed them with values from object file.
-       This operation takes some time so progress bar will be displayed.*/
-    if(!objFile.open(QIODevice::ReadOnly)) return 0;
+    bParsed = true;
 
-    vertices = new sPoint3[numVertices];
-    textures = new sPoint3[numTextures];
-    normals = new sPoint3[numNormals];
-    faces = new QList<sFace>[numFaces];
+    return 1;
+}
 
-    if(progress_bar != NULL)
-        progress_bar->setRange(0, numVertices+numTextures+numNormals+numFaces);
-    if(progress_label != NULL)
-    {
-        progress_label->setText(str);
-        progress_label->repaint();
-    }
+/*!
+ * \brief Builds indexed triangle mesh from parsed data.
+ *
+ * Every face corner is a (vertex, texture, normal) triple. Corners with the
+ * same triple are welded to one vertex of meshVertices, so vertices shared by
+ * neighbouring faces are stored only once. Faces are triangulated as fans
+ * (the way GL_POLYGON draws convex faces), meshIndices holds 3 indices per
+ * triangle. Faces referring to vertices that do not exist are skipped.
+ *
+ * Obj files without any normals get them from cObj2OGL::generateNormals().
+ * If bOptimizeMesh is set, the mesh is reordered by cObj2OGL::optimizeMesh()
+ * and its average cache miss ratio before and after is kept. Simplified
+ * LODs are added by cObj2OGL::buildLods(), points of convex hull are picked
+ * by cObj2OGL::buildHull(). If bPackVertices is set, packed vertices are made
+ * by cObj2OGL::packMesh().
+ *
+ * Built mesh is written to the mesh cache of the obj file. Mesh mapped from
+ * the cache by cObj2OGL::loadMeshCache() is used as it is. Parsed data are
+ * freed then, and so is meshVertices when packed vertices were made, the
+ * mesh can only be built once per parsing.
+ *
+ * \return false if there is nothing parsed to build the mesh from.
+ */
+bool cObj2OGL::buildMesh()
+{
+    if(bMeshCached) return true;
 
-    /*for(int i=0; i < numVertices; i++)
-    {
-        normals[i].x = 0.0;
-        normals[i].y = 0.0;
-        normals[i].z = 0.0;
-    }*/
+    meshVertexData = NULL;
+    meshPackedData = NULL;
+    meshIndexData = NULL;
+    nMeshVertices = 0;
+    nMeshIndices = 0;
+    meshVertices.clear();
+    meshPackedVertices.clear();
+    meshIndices.clear();
+    meshLodOffsets.clear();
+    meshHull.clear();
+
+    if(!bParsed) return false;
+    if(vertices.isEmpty()) return false;
 
-    // its important to zero these before while loop
-    int nV = 0;
-    int nT = 0;
-    int nN = 0;
-    int nF = 0;
-    QStringList tempLineSegments;
-    QStringList tempFaceSegments;
-    sFace tempFace;
-    while(nV < numVertices || nT < numTextures || nN < numNormals ||
-          nF < numFaces)
+    QHash<sFace, GLuint> welded;
+    welded.reserve(numVertices);
+    meshVertices.reserve(numVertices);
+    meshIndices.reserve(3*numFaces);
+
+    QVector<GLuint> corners;
+    for(int i = 0; i < numFaces; i++)
     {
+        int size = faceOffsets.at(i+1) - faceOffsets.at(i);
 
-        if(progress_bar != NULL)
+        // whole face is skipped before any of its corners is welded
+        bool bValid = true;
+        for(int k = 0; k < size && bValid; k++)
         {
-            //qApp->processEvents();
-            progress_bar->setValue(nV+nT+nN+nF);
+            int vert = faceCorners.at(faceOffsets.at(i) + k).vertIndex;
+            bValid = vert >= 0 && vert < numVertices;
         }
+        if(!bValid)
+            continue;
 
-        line = objFile.readLine();
-        if(line.contains(regV))
+        corners.clear();
+        for(int k = 0; k < size; k++)
         {
-            tempLineSegments = line.split(" ");
-            if(tempLineSegments.size() > 3)
-            {
-                vertices[nV].x = tempLineSegments.at(1).toFloat();
-                vertices[nV].y = tempLineSegments.at(2).toFloat();
-                vertices[nV].z = tempLineSegments.at(3).toFloat();
-            } else
+            const sFace &face = faceCorners.at(faceOffsets.at(i) + k);
+            QHash<sFace, GLuint>::const_iterator it = welded.constFind(face);
+            if(it != welded.constEnd())
             {
-                vertices[nV].x = 0.0;
-                vertices[nV].y = 0.0;
-                vertices[nV].z = 0.0;
+                corners.append(it.value());
+                continue;
             }
-            nV++;
-        } else
-        if(line.contains(regT))
-        {
-            tempLineSegments = line.split(" ");
-            if(tempLineSegments.size() > 2)
+
+            sVertex v;
+            v.x = vertices[face.vertIndex].x;
+            v.y = vertices[face.vertIndex].y;
+            v.z = vertices[face.vertIndex].z;
+            if(face.normIndex >= 0 && face.normIndex < numNormals)
             {
-                textures[nT].x = tempLineSegments.at(1).toFloat();
-                textures[nT].y = tempLineSegments.at(2).toFloat();
-                textures[nT].z = 0.0;
-                if(tempLineSegments.size() > 3)
-                    textures[nT].z = tempLineSegments.at(3).toFloat();
+                v.nx = normals[face.normIndex].x;
+                v.ny = normals[face.normIndex].y;
+                v.nz = normals[face.normIndex].z;
             } else
             {
-                textures[nT].x = 0.0;
-                textures[nT].y = 0.0;
-                textures[nT].z = 0.0;
+                v.nx = 1.0;
+                v.ny = 0.0;
+                v.nz = 0.0;
             }
-            nT++;
-        } else
-        if(line.contains(regN))
-        {
-            tempLineSegments = line.split(" ");
-            if(tempLineSegments.size() > 3)
+            if(face.textIndex >= 0 && face.textIndex < numTextures)
             {
-                normals[nN].x = tempLineSegments.at(1).toFloat();
-                normals[nN].y = tempLineSegments.at(2).toFloat();
-                normals[nN].z = tempLineSegments.at(3).toFloat();
+                v.s = textures[face.textIndex].x;
+                v.t = textures[face.textIndex].y;
             } else
             {
-                normals[nN].x = 1.0;
-                normals[nN].y = 0.0;
-                normals[nN].z = 0.0;
+                v.s = 0.0;
+                v.t = 0.0;
             }
-            nN++;
-        } else
-        if(line.contains(regF))
+
+            GLuint index = meshVertices.size();
+            meshVertices.append(v);
+            welded.insert(face, index);
+            corners.append(index);
+        }
+
+        for(int k = 1; k+1 < corners.size(); k++)
         {
-            tempLineSegments = line.split(" ");
-            for(int i = 1; i < tempLineSegments.size(); i++)
-            {
-                tempFaceSegments = tempLineSegments.at(i).split("/");
-                if(tempFaceSegments.size() == 3)
-                {
-                    tempFace.vertIndex = tempFaceSegments.at(0).toInt()-1;
-                    tempFace.textIndex = tempFaceSegments.at(1).toInt()-1;
-                    tempFace.normIndex = tempFaceSegments.at(2).toInt()-1;
-                    faces[nF].append(tempFace);
-                } else
-                {
-                    tempFace.vertIndex = 0;
-                    tempFace.textIndex = 0;
-                    tempFace.normIndex = 0;
-                    faces[nF].append(tempFace);
-                }
-            }
-            nF++;
+            meshIndices.append(corners.at(0));
+            meshIndices.append(corners.at(k));
+            meshIndices.append(corners.at(k+1));
         }
     }
 
-    // end progress
-    if(progress_bar != NULL)
-        progress_bar->setValue(numVertices+numTextures+numNormals+numFaces);
+    if(numNormals == 0)
+        generateNormals();
 
-    objFile.close();
+    if(bOptimizeMesh)
+        optimizeMesh();
 
-    //normalizeVertexNormals();
+    buildLods();
 
-    bParsed = true;
+    meshVertexData = meshVertices.constData();
+    meshIndexData = meshIndices.constData();
+    nMeshVertices = meshVertices.size();
+    nMeshIndices = meshIndices.size();
 
-    return 1;
+    for(int i = 0; i < nMeshVertices; i++)
+    {
+        const sVertex &v = meshVertices.at(i);
+        if(i == 0 || v.x < meshMin.x) meshMin.x = v.x;
+        if(i == 0 || v.y < meshMin.y) meshMin.y = v.y;
+        if(i == 0 || v.z < meshMin.z) meshMin.z = v.z;
+        if(i == 0 || v.x > meshMax.x) meshMax.x = v.x;
+        if(i == 0 || v.y > meshMax.y) meshMax.y = v.y;
+        if(i == 0 || v.z > meshMax.z) meshMax.z = v.z;
+    }
+
+    buildHull();
+
+    if(bPackVertices)
+        packMesh();
+
+    saveMeshCache();
+
+    freeMemory();
+    bParsed = false;
+    if(meshPackedData != NULL)
+    {
+        meshVertices.clear();
+        meshVertexData = NULL;
+    }
+
+    return true;
+}
+
+// positions of vertices are compared bitwise, -0.0 is made 0.0 first
+inline bool operator==(const sPoint3 &a, const sPoint3 &b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+inline uint qHash(const sPoint3 &p)
+{
+    float c[3] = {p.x + 0.0f, p.y + 0.0f, p.z + 0.0f};
+    uint h[3];
+    memcpy(h, c, sizeof(h));
+    return h[0]*73856093u ^ h[1]*19349663u ^ h[2]*83492791u;
 }
 
 /*!
- * \brief Compute face normal.
- *
- * Face normal for a face specified by 3 points in 3D space will be calculated
+ * \brief Groups vertices at the same position into classes.
  *
- * \return Calculated face normal.
+ * Vertices split by texture coordinates or normals share a class. Class of
+ * vertex i goes to vertexClass[i], position of class c to positions[c].
  */
-sPoint3 cObj2OGL::computeFaceNormal(int index0, int index1, int index2)
+static void positionClasses(const QVector<sVertex> &vertices,
+                            QVector<int> &vertexClass,
+                            QVector<sPoint3> &positions)
 {
-    sPoint3 retPoint;
+    int nVertices = vertices.size();
+    vertexClass.resize(nVertices);
+    positions.clear();
 
-    float dx1 = vertices[index1].x - vertices[index0].x;
-    float dy1 = vertices[index1].y - vertices[index0].y;
-    float dz1 = vertices[index1].z - vertices[index0].z;
-    float dx2 = vertices[index2].x - vertices[index0].x;
-    float dy2 = vertices[index2].y - vertices[index0].y;
-    float dz2 = vertices[index2].z - vertices[index0].z;
-    retPoint.x = dy1*dz2 - dz1*dy2;
-    retPoint.y = dz1*dx2 - dx1*dz2;
-    retPoint.z = dx1*dy2 - dy1*dx2;
-    float d = sqrt(retPoint.x*retPoint.x + retPoint.y*retPoint.y + \
-                   retPoint.z*retPoint.z);
-
-    if (d == 0.0)
-    {
-      retPoint.x = 1;
-      retPoint.y = 0;
-      retPoint.z = 0;
-    }
-    else
+    QHash<sPoint3, int> classes;
+    classes.reserve(nVertices);
+    for(int i = 0; i < nVertices; i++)
     {
-      retPoint.x /= d;
-      retPoint.y /= d;
-      retPoint.z /= d;
+        sPoint3 p;
+        p.x = vertices.at(i).x + 0.0f;
+        p.y = vertices.at(i).y + 0.0f;
+        p.z = vertices.at(i).z + 0.0f;
+        QHash<sPoint3, int>::const_iterator it = classes.constFind(p);
+        if(it != classes.constEnd())
+        {
+            vertexClass[i] = it.value();
+            continue;
+        }
+        vertexClass[i] = positions.size();
+        classes.insert(p, positions.size());
+        positions.append(p);
     }
-    return retPoint;
 }
 
+// triangles or vertices handled by one job of cObj2OGL::generateNormals()
+static const int normalJobMin = 16*1024;
+
 /*!
- * \brief Calculate vertex normals.
+ * \brief Range of mesh generateNormals() job works on and data it needs.
  *
- * Normalizing vertex and face normals is good habit. Some implementations of
- * OpenGL may have problem with unnormalized vertex normals. After all the name
- * normal speaks for itself.
+ * Face normals job fills faceNormals (and cornerAngles) of triangles <first,
+ * last), class normals job sums them to position classes <first, last)
+ * through adjacency, vertex normals job copies them to vertices <first,
+ * last). No two jobs ever write the same data.
+ */
+struct sNormalJob {
+    sVertex *vertices;
+    const GLuint *indices;
+    sPoint3 *faceNormals;
+    float *cornerAngles;     // 3 per triangle, for angle weighting only
+    const int *cornerOffsets; // class c is corner corners[
+    const int *corners;      // cornerOffsets[c]] ... of triangles
+    const int *vertexClass;  // position class of every vertex
+    sPoint3 *classNormals;   // zero for class of no proper triangle
+    bool bAngle;
+    int first;
+    int last;
+};
+
+// angles of triangle corners add up to Pi
+static const float Pi = 3.14159265358979323846f;
+
+/*!
+ * \brief Angle between edges (dx1, dy1, dz1) and (dx2, dy2, dz2).
+ */
+static float edgeAngle(float dx1, float dy1, float dz1,
+                       float dx2, float dy2, float dz2)
+{
+    float d = sqrt((dx1*dx1 + dy1*dy1 + dz1*dz1) *
+                   (dx2*dx2 + dy2*dy2 + dz2*dz2));
+    if(d == 0.0) return 0.0;
+
+    float cosAngle = (dx1*dx2 + dy1*dy2 + dz1*dz2) / d;
+    return acos(qBound(-1.0f, cosAngle, 1.0f));
+}
+
+/*!
+ * \brief Normals of triangles, unit for angle weighting, else twice the area
+ * long. Angles at corners of triangles for angle weighting.
  */
-void cObj2OGL::normalizeVertexNormals()
+static void faceNormalJob(sNormalJob *job)
 {
-    float d;
-    for(int i=0; i < numVertices; i++)
+    for(int t = job->first; t < job->last; t++)
     {
-     d = sqrt(normals[i].x*normals[i].x + normals[i].y*normals[i].y + \
-              normals[i].z*normals[i].z);
+        const sVertex &a = job->vertices[job->indices[3*t]];
+        const sVertex &b = job->vertices[job->indices[3*t+1]];
+        const sVertex &c = job->vertices[job->indices[3*t+2]];
+        float dx1 = b.x - a.x;
+        float dy1 = b.y - a.y;
+        float dz1 = b.z - a.z;
+        float dx2 = c.x - a.x;
+        float dy2 = c.y - a.y;
+        float dz2 = c.z - a.z;
+
+        sPoint3 &n = job->faceNormals[t];
+        n.x = dy1*dz2 - dz1*dy2;
+        n.y = dz1*dx2 - dx1*dz2;
+        n.z = dx1*dy2 - dy1*dx2;
+        if(!job->bAngle) continue;
 
-      if (d == 0.0)
-      {
-        //normals[i].x = 1;
-        //normals[i].y = 0;
-        //normals[i].z = 0;
-      }
-      else
-      {
-        normals[i].x /= d;
-        normals[i].y /= d;
-        normals[i].z /= d;
-      }
+        float d = sqrt(n.x*n.x + n.y*n.y + n.z*n.z);
+        if(d > 0.0)
+        {
+            n.x /= d;
+            n.y /= d;
+            n.z /= d;
+        }
 
+        float *angle = job->cornerAngles + 3*t;
+        angle[0] = edgeAngle(dx1, dy1, dz1, dx2, dy2, dz2);
+        angle[1] = edgeAngle(c.x - b.x, c.y - b.y, c.z - b.z,
+                             -dx1, -dy1, -dz1);
+        angle[2] = Pi - angle[0] - angle[1];
     }
 }
 
 /*!
- * \brief Creates display list.
- *
- * Create display list from data geathered by obj2OGL parser. This method gets
- * called from within cObj2OGL::makeObjectFromObjFileWithNormals() and
- * cObj2OGL::makeObjectFromObjFileWithNormals() methods. It's purpose is to keep
- * things simple. Or it may be also used by object that uses this parser.
- *
- * \return ID of compiled display list.
+ * \brief Normals of position classes, weighted sums of normals of their
+ * triangles.
  */
-GLuint cObj2OGL::createDisplayList()
+static void classNormalJob(sNormalJob *job)
 {
-    if(!bParsed) return 0;
-    if(vertices == NULL || normals == NULL) return 0;
-    
-    GLuint displayList = glGenLists(1);
-    glNewList(displayList, GL_COMPILE);
-
-    int indexV;
-    //int indexT;
-    int indexN;
-    for(int i = 0; i < numFaces; i++)
+    for(int i = job->first; i < job->last; i++)
     {
-        if(faces[i].size() == 3) glBegin(GL_TRIANGLES);
-        else if (faces[i].size() == 4) glBegin(GL_QUADS);
-        else glBegin(GL_POLYGON);
-        for(int k = 0; k < faces[i].size(); k++)
-        {
-            indexV = faces[i].at(k).vertIndex;
-            //indexT = faces[i].at(k).textIndex;
-            indexN = faces[i].at(k).normIndex;
-            glNormal3f(normals[indexN].x,
-                       normals[indexN].y,
-                       normals[indexN].z);
-            glVertex3f(vertices[indexV].x,
-                       vertices[indexV].y,
-                       vertices[indexV].z);
+        float x = 0.0, y = 0.0, z = 0.0;
+        for(int c = job->cornerOffsets[i]; c < job->cornerOffsets[i+1]; c++)
+        {
+            int k = job->corners[c];
+            const sPoint3 &n = job->faceNormals[k/3];
+            float w = job->bAngle ? job->cornerAngles[k] : 1.0;
+            x += w*n.x;
+            y += w*n.y;
+            z += w*n.z;
         }
-        glEnd();
+
+        sPoint3 &n = job->classNormals[i];
+        float d = sqrt(x*x + y*y + z*z);
+        n.x = (d > 0.0) ? x/d : 0.0;
+        n.y = (d > 0.0) ? y/d : 0.0;
+        n.z = (d > 0.0) ? z/d : 0.0;
     }
+}
+
+/*!
+ * \brief Normals of vertices, normals of their position classes.
+ */
+static void vertexNormalJob(sNormalJob *job)
+{
+    for(int i = job->first; i < job->last; i++)
+    {
+        const sPoint3 &n = job->classNormals[job->vertexClass[i]];
+        if(n.x == 0.0 && n.y == 0.0 && n.z == 0.0) continue;
 
-    glEndList();
+        sVertex &v = job->vertices[i];
+        v.nx = n.x;
+        v.ny = n.y;
+        v.nz = n.z;
+    }
+}
 
-    return displayList;
+/*!
+ * \brief Runs job over <0, count) split into ranges of at least normalJobMin.
+ *
+ * First range is done by the calling thread, the others in the global
+ * thread pool.
+ */
+static void runNormalJobs(void (*job)(sNormalJob *), const sNormalJob &data,
+                          int count)
+{
+    int nJobs = qMin(count/normalJobMin + 1,
+                     qMax(1, QThread::idealThreadCount()));
+
+    QVector<sNormalJob> jobs(nJobs, data);
+    for(int i = 0; i < nJobs; i++)
+    {
+        jobs[i].first = (qint64) count*i/nJobs;
+        jobs[i].last = (qint64) count*(i+1)/nJobs;
+    }
+
+    QList< QFuture<void> > futures;
+    for(int i = 1; i < nJobs; i++)
+        futures.append(QtConcurrent::run(job, jobs.data() + i));
+    job(jobs.data());
+    for(int i = 0; i < futures.size(); i++)
+        futures[i].waitForFinished();
+}
+
+/*!
+ * \brief Generates normals of meshVertices from triangles of meshIndices.
+ *
+ * Normals of all triangles are computed first. Vertices at the same position
+ * (welded apart by texture coordinates) form a class, so seams of texture
+ * are not seen in lighting. Every class sums the normals of triangles using
+ * it, found by class to triangle adjacency, and normalizes the sum, which is
+ * then copied to its vertices. Triangles are weighted by normalWeighting.
+ * All passes are split into jobs running in parallel for big meshes.
+ * Vertices used by no triangle or only by degenerate ones keep their normals.
+ */
+void cObj2OGL::generateNormals()
+{
+    int nVertices = meshVertices.size();
+    int nTriangles = meshIndices.size()/3;
+    if(nTriangles == 0) return;
+
+    QVector<int> vertexClass;
+    QVector<sPoint3> positions;
+    positionClasses(meshVertices, vertexClass, positions);
+    int nClasses = positions.size();
+
+    // corners k of meshIndices at class c, corner k is in triangle k/3
+    QVector<int> offsets(nClasses + 1, 0);
+    for(int k = 0; k < 3*nTriangles; k++)
+        offsets[vertexClass[meshIndices.at(k)] + 1]++;
+    for(int c = 0; c < nClasses; c++)
+        offsets[c+1] += offsets[c];
+    QVector<int> corners(3*nTriangles);
+    QVector<int> cursor(offsets);
+    for(int k = 0; k < 3*nTriangles; k++)
+        corners[cursor[vertexClass[meshIndices.at(k)]]++] = k;
+
+    bool bAngle = normalWeighting == AngleWeighting;
+    QVector<sPoint3> faceNormals(nTriangles);
+    QVector<float> cornerAngles(bAngle ? 3*nTriangles : 0);
+    QVector<sPoint3> classNormals(nClasses);
+
+    sNormalJob data;
+    data.vertices = meshVertices.data();
+    data.indices = meshIndices.constData();
+    data.faceNormals = faceNormals.data();
+    data.cornerAngles = cornerAngles.data();
+    data.cornerOffsets = offsets.constData();
+    data.corners = corners.constData();
+    data.vertexClass = vertexClass.constData();
+    data.classNormals = classNormals.data();
+    data.bAngle = bAngle;
+    data.first = 0;
+    data.last = 0;
+
+    runNormalJobs(faceNormalJob, data, nTriangles);
+    runNormalJobs(classNormalJob, data, nClasses);
+    runNormalJobs(vertexNormalJob, data, nVertices);
+}
+
+// LODs made by cObj2OGL::buildLods(), including the full mesh, each has a
+// quarter of triangles of the previous one
+static const int maxMeshLods = 5;
+// LOD is not made with fewer triangles than this
+static const int lodMinTriangles = 64;
+// weight of planes keeping open borders of the mesh in place
+static const double lodBorderWeight = 100.0;
+// collapse is refused when the class would be used by more triangles, keeps
+// triangle soups from piling up at few classes
+static const int lodMaxValence = 32;
+// LODs are not made when more edges than this part are open borders, such
+// mesh is a soup of triangles rather than a surface
+static const double lodMaxBorderEdges = 0.5;
+
+/*!
+ * \brief Symmetric 4x4 matrix of quadric error, sum of squared distances to
+ * planes (xx, xy, xz, xw, yy, yz, yw, zz, zw, ww).
+ */
+struct sQuadric {
+    double a[10];
+};
+
+static void addPlane(sQuadric &q, double nx, double ny, double nz, double d,
+                     double w)
+{
+    q.a[0] += w*nx*nx;
+    q.a[1] += w*nx*ny;
+    q.a[2] += w*nx*nz;
+    q.a[3] += w*nx*d;
+    q.a[4] += w*ny*ny;
+    q.a[5] += w*ny*nz;
+    q.a[6] += w*ny*d;
+    q.a[7] += w*nz*nz;
+    q.a[8] += w*nz*d;
+    q.a[9] += w*d*d;
+}
+
+static double quadricError(const sQuadric &q, const sQuadric &r,
+                           const sPoint3 &p)
+{
+    double a[10];
+    for(int i = 0; i < 10; i++)
+        a[i] = q.a[i] + r.a[i];
+    double x = p.x, y = p.y, z = p.z;
+    return a[0]*x*x + 2.0*a[1]*x*y + 2.0*a[2]*x*z + 2.0*a[3]*x +
+           a[4]*y*y + 2.0*a[5]*y*z + 2.0*a[6]*y +
+           a[7]*z*z + 2.0*a[8]*z + a[9];
+}
+
+/*!
+ * \brief Edge collapse waiting in the heap of cObj2OGL::buildLods().
+ *
+ * Collapse moves class from onto class to. It is stale when either class
+ * changed since it was pushed.
+ */
+struct sCollapse {
+    double cost;
+    int from;
+    int to;
+    int fromVersion;
+    int toVersion;
+};
+
+// heap of collapses is ordered by the lowest cost first
+static bool cheaperCollapse(const sCollapse &a, const sCollapse &b)
+{
+    return a.cost > b.cost;
+}
+
+/*!
+ * \brief Mesh of vertex classes simplified by cObj2OGL::buildLods().
+ */
+struct sLodMesh {
+    QVector<sPoint3> pos;          // position of class
+    QVector<sQuadric> quadric;
+    QVector<int> collapsedTo;      // class it was collapsed onto, or -1
+    QVector<int> version;
+    QVector< QVector<int> > tris;  // triangles using class, some dead
+    QVector<int> tri;              // 3 classes per triangle
+    QVector<bool> alive;           // triangle
+    int liveTriangles;
+    QVector<sCollapse> heap;
+    QVector<int> mark;             // see pushCollapses()
+    int markStamp;
+};
+
+static sPoint3 triangleNormal(const sPoint3 &a, const sPoint3 &b,
+                              const sPoint3 &c)
+{
+    sPoint3 n;
+    float dx1 = b.x - a.x;
+    float dy1 = b.y - a.y;
+    float dz1 = b.z - a.z;
+    float dx2 = c.x - a.x;
+    float dy2 = c.y - a.y;
+    float dz2 = c.z - a.z;
+    n.x = dy1*dz2 - dz1*dy2;
+    n.y = dz1*dx2 - dx1*dz2;
+    n.z = dx1*dy2 - dy1*dx2;
+    return n;
+}
+
+/*!
+ * \brief Pushes the cheaper direction of collapsing edge (u, v).
+ */
+static void pushCollapse(sLodMesh &m, int u, int v)
+{
+    double toU = quadricError(m.quadric[u], m.quadric[v], m.pos[u]);
+    double toV = quadricError(m.quadric[u], m.quadric[v], m.pos[v]);
+
+    sCollapse c;
+    c.cost = qMin(toU, toV);
+    c.from = (toU < toV) ? v : u;
+    c.to = (toU < toV) ? u : v;
+    c.fromVersion = m.version[c.from];
+    c.toVersion = m.version[c.to];
+    m.heap.append(c);
+    std::push_heap(m.heap.begin(), m.heap.end(), cheaperCollapse);
+}
+
+/*!
+ * \brief Pushes collapses of all edges of class u.
+ */
+static void pushCollapses(sLodMesh &m, int u)
+{
+    m.markStamp++;
+    m.mark[u] = m.markStamp;
+    const QVector<int> &tris = m.tris[u];
+    for(int i = 0; i < tris.size(); i++)
+    {
+        if(!m.alive[tris[i]]) continue;
+        for(int k = 0; k < 3; k++)
+        {
+            int v = m.tri[3*tris[i] + k];
+            if(m.mark[v] == m.markStamp) continue;
+            m.mark[v] = m.markStamp;
+            pushCollapse(m, u, v);
+        }
+    }
+}
+
+/*!
+ * \brief Collapses class c.from onto c.to, unless it flips a triangle or
+ * makes too big a fan.
+ *
+ * Triangles using both classes disappear, the others get c.to instead of
+ * c.from.
+ *
+ * \return false if the collapse was stale or refused.
+ */
+static bool applyCollapse(sLodMesh &m, const sCollapse &c)
+{
+    int a = c.from;
+    int b = c.to;
+    if(m.collapsedTo[a] >= 0 || m.collapsedTo[b] >= 0) return false;
+    if(m.version[a] != c.fromVersion || m.version[b] != c.toVersion)
+        return false;
+    if(m.tris[a].size() + m.tris[b].size() > lodMaxValence) return false;
+
+    const QVector<int> &trisA = m.tris[a];
+    for(int i = 0; i < trisA.size(); i++)
+    {
+        int t = trisA[i];
+        if(!m.alive[t]) continue;
+        const int *v = m.tri.constData() + 3*t;
+        if(v[0] == b || v[1] == b || v[2] == b) continue;
+
+        sPoint3 p[3], q[3];
+        for(int k = 0; k < 3; k++)
+        {
+            p[k] = m.pos[v[k]];
+            q[k] = (v[k] == a) ? m.pos[b] : p[k];
+        }
+        sPoint3 n0 = triangleNormal(p[0], p[1], p[2]);
+        sPoint3 n1 = triangleNormal(q[0], q[1], q[2]);
+        if(n0.x*n1.x + n0.y*n1.y + n0.z*n1.z <= 0.0) return false;
+    }
+
+    for(int i = 0; i < trisA.size(); i++)
+    {
+        int t = trisA[i];
+        if(!m.alive[t]) continue;
+        int *v = m.tri.data() + 3*t;
+        if(v[0] == b || v[1] == b || v[2] == b)
+        {
+            m.alive[t] = false;
+            m.liveTriangles--;
+            continue;
+        }
+        for(int k = 0; k < 3; k++)
+            if(v[k] == a) v[k] = b;
+        m.tris[b].append(t);
+    }
+
+    QVector<int> &trisB = m.tris[b];
+    int live = 0;
+    for(int i = 0; i < trisB.size(); i++)
+        if(m.alive[trisB[i]]) trisB[live++] = trisB[i];
+    trisB.resize(live);
+    m.tris[a] = QVector<int>();
+
+    for(int i = 0; i < 10; i++)
+        m.quadric[b].a[i] += m.quadric[a].a[i];
+    m.collapsedTo[a] = b;
+    m.version[b]++;
+
+    pushCollapses(m, b);
+    return true;
+}
+
+/*!
+ * \brief Builds simplified LODs of the mesh by quadric edge collapse.
+ *
+ * Vertices at the same position (split by texture coordinates or normals)
+ * form one class, simplification works on classes so the mesh never tears
+ * along its seams. Every class has the quadric of planes of its triangles,
+ * weighted by their area, open borders add perpendicular planes so that they
+ * keep their shape. Edge collapse with the lowest quadric error is done
+ * first, onto one of its end points. Collapses flipping a triangle are
+ * refused.
+ *
+ * LOD triangles keep the order of the full mesh and refer to the original
+ * vertices, corner whose class was collapsed takes the vertex of the new
+ * class with the closest normal and texture coordinates. LODs are appended
+ * to meshIndices, LOD i is meshIndices meshLodOffsets[i] ...
+ * meshLodOffsets[i+1]-1. Full mesh is LOD 0. Mesh with too many open edges
+ * (lodOpenEdges of lodEdges) gets no LODs.
+ */
+void cObj2OGL::buildLods()
+{
+    int nVertices = meshVertices.size();
+    int nTriangles = meshIndices.size()/3;
+    meshLodOffsets.clear();
+    meshLodOffsets.append(0);
+    meshLodOffsets.append(meshIndices.size());
+    lodEdges = 0;
+    lodOpenEdges = 0;
+    if(!bBuildLods || nTriangles/4 < lodMinTriangles) return;
+
+    sLodMesh m;
+
+    // classes of vertices, members of class c are vertices classMembers[
+    // classOffsets[c]] ... classMembers[classOffsets[c+1]-1]
+    QVector<int> vertexClass;
+    positionClasses(meshVertices, vertexClass, m.pos);
+    int nClasses = m.pos.size();
+    QVector<int> classOffsets(nClasses + 1, 0);
+    for(int i = 0; i < nVertices; i++)
+        classOffsets[vertexClass[i] + 1]++;
+    for(int c = 0; c < nClasses; c++)
+        classOffsets[c+1] += classOffsets[c];
+    QVector<int> classMembers(nVertices);
+    QVector<int> cursor(classOffsets);
+    for(int i = 0; i < nVertices; i++)
+        classMembers[cursor[vertexClass[i]]++] = i;
+
+    sQuadric zero;
+    memset(&zero, 0, sizeof(zero));
+    m.quadric.fill(zero, nClasses);
+    m.collapsedTo.fill(-1, nClasses);
+    m.version.fill(0, nClasses);
+    m.tris.resize(nClasses);
+    m.mark.fill(0, nClasses);
+    m.markStamp = 0;
+    m.tri.resize(3*nTriangles);
+    m.alive.fill(true, nTriangles);
+    m.liveTriangles = nTriangles;
+
+    // quadrics of triangle planes, uses of edges to find open borders
+    QHash<quint64, int> edgeUses;
+    for(int t = 0; t < nTriangles; t++)
+    {
+        int *v = m.tri.data() + 3*t;
+        for(int k = 0; k < 3; k++)
+            v[k] = vertexClass[meshIndices.at(3*t + k)];
+        if(v[0] == v[1] || v[1] == v[2] || v[2] == v[0])
+        {
+            m.alive[t] = false;
+            m.liveTriangles--;
+            continue;
+        }
+        for(int k = 0; k < 3; k++)
+        {
+            m.tris[v[k]].append(t);
+            int u = qMin(v[k], v[(k+1)%3]);
+            int w = qMax(v[k], v[(k+1)%3]);
+            edgeUses[((quint64) u << 32) | (quint64) w]++;
+        }
+
+        sPoint3 n = triangleNormal(m.pos[v[0]], m.pos[v[1]], m.pos[v[2]]);
+        double area2 = sqrt(n.x*n.x + n.y*n.y + n.z*n.z);
+        if(area2 == 0.0) continue;
+        double nx = n.x/area2, ny = n.y/area2, nz = n.z/area2;
+        double d = -(nx*m.pos[v[0]].x + ny*m.pos[v[0]].y +
+                     nz*m.pos[v[0]].z);
+        for(int k = 0; k < 3; k++)
+            addPlane(m.quadric[v[k]], nx, ny, nz, d, area2/2.0);
+    }
+
+    for(QHash<quint64, int>::const_iterator it = edgeUses.constBegin();
+        it != edgeUses.constEnd(); ++it)
+        if(it.value() == 1) lodOpenEdges++;
+    lodEdges = edgeUses.size();
+    if(lodOpenEdges > lodMaxBorderEdges*lodEdges)
+        return;
+
+    for(int t = 0; t < nTriangles; t++)
+    {
+        if(!m.alive[t]) continue;
+        const int *v = m.tri.constData() + 3*t;
+        sPoint3 n = triangleNormal(m.pos[v[0]], m.pos[v[1]], m.pos[v[2]]);
+        for(int k = 0; k < 3; k++)
+        {
+            int u = qMin(v[k], v[(k+1)%3]);
+            int w = qMax(v[k], v[(k+1)%3]);
+            if(edgeUses.value(((quint64) u << 32) | (quint64) w) != 1)
+                continue;
+
+            // plane through the border edge, perpendicular to triangle
+            const sPoint3 &p = m.pos[v[k]];
+            const sPoint3 &q = m.pos[v[(k+1)%3]];
+            double ex = q.x - p.x, ey = q.y - p.y, ez = q.z - p.z;
+            double bx = ey*n.z - ez*n.y;
+            double by = ez*n.x - ex*n.z;
+            double bz = ex*n.y - ey*n.x;
+            double len = sqrt(bx*bx + by*by + bz*bz);
+            if(len == 0.0) continue;
+            bx /= len;
+            by /= len;
+            bz /= len;
+            double d = -(bx*p.x + by*p.y + bz*p.z);
+            double w2 = lodBorderWeight*(ex*ex + ey*ey + ez*ez);
+            addPlane(m.quadric[v[k]], bx, by, bz, d, w2);
+            addPlane(m.quadric[v[(k+1)%3]], bx, by, bz, d, w2);
+        }
+    }
+
+    for(QHash<quint64, int>::const_iterator it = edgeUses.constBegin();
+        it != edgeUses.constEnd(); ++it)
+        pushCollapse(m, (int) (it.key() >> 32),
+                     (int) (it.key() & 0xffffffffu));
+
+    QVector<GLuint> lods;
+    int target = nTriangles/4;
+    while(meshLodOffsets.size() <= maxMeshLods && target >= lodMinTriangles)
+    {
+        while(m.liveTriangles > target && !m.heap.isEmpty())
+        {
+            std::pop_heap(m.heap.begin(), m.heap.end(), cheaperCollapse);
+            sCollapse c = m.heap.last();
+            m.heap.resize(m.heap.size() - 1);
+            applyCollapse(m, c);
+        }
+        if(m.liveTriangles > target + target/2) break; // can not simplify
+
+        for(int t = 0; t < nTriangles; t++)
+        {
+            if(!m.alive[t]) continue;
+            for(int k = 0; k < 3; k++)
+            {
+                GLuint i = meshIndices.at(3*t + k);
+                int c = m.tri[3*t + k];
+                if(vertexClass[i] == c)
+                {
+                    lods.append(i);
+                    continue;
+                }
+
+                // member of class c most like vertex i
+                const sVertex &v = meshVertices.at(i);
+                GLuint best = classMembers[classOffsets[c]];
+                float bestScore = -1e30f;
+                for(int j = classOffsets[c]; j < classOffsets[c+1]; j++)
+                {
+                    const sVertex &w = meshVertices.at(classMembers[j]);
+                    float score = v.nx*w.nx + v.ny*w.ny + v.nz*w.nz -
+                                  fabs(v.s - w.s) - fabs(v.t - w.t);
+                    if(score > bestScore)
+                    {
+                        bestScore = score;
+                        best = classMembers[j];
+                    }
+                }
+                lods.append(best);
+            }
+        }
+        meshLodOffsets.append(meshIndices.size() + lods.size());
+        target /= 4;
+    }
+    meshIndices += lods;
+}
+
+// directions in which points of convex hull are searched for, the hull has
+// at most this many points
+static const int hullDirections = 256;
+
+/*!
+ * \brief Picks points of convex hull of the built mesh into meshHull.
+ *
+ * The farthest vertex in each of hullDirections directions spread evenly
+ * over the sphere (Fibonacci lattice) is a vertex of the convex hull. Such
+ * support points of all directions are a decimated hull, detailed enough for
+ * collisions of the ship with walls of the wormhole. Only distinct positions
+ * of meshVertices are searched, vertices split by normals or texture
+ * coordinates are skipped.
+ */
+void cObj2OGL::buildHull()
+{
+    meshHull.clear();
+    if(meshVertices.isEmpty()) return;
+
+    QVector<int> vertexClass;
+    QVector<sPoint3> positions;
+    positionClasses(meshVertices, vertexClass, positions);
+    int nPositions = positions.size();
+
+    static const float golden = 2.39996323f; // golden angle in radians
+    QVector<int> support(hullDirections);
+    for(int i = 0; i < hullDirections; i++)
+    {
+        float dz = 1.0 - (2*i + 1) / (float) hullDirections;
+        float r = sqrt(1.0 - dz*dz);
+        float dx = r*cos(golden*i);
+        float dy = r*sin(golden*i);
+
+        int best = 0;
+        float bestDot = 0.0;
+        for(int k = 0; k < nPositions; k++)
+        {
+            const sPoint3 &v = positions.at(k);
+            float dot = v.x*dx + v.y*dy + v.z*dz;
+            if(k == 0 || dot > bestDot)
+            {
+                bestDot = dot;
+                best = k;
+            }
+        }
+        support[i] = best;
+    }
+
+    std::sort(support.begin(), support.end());
+    QVector<int>::iterator end = std::unique(support.begin(), support.end());
+    for(QVector<int>::iterator it = support.begin(); it != end; ++it)
+        meshHull.append(positions.at(*it));
+}
+
+/*!
+ * \brief Packs built mesh into meshPackedVertices.
+ *
+ * Positions are stored relative to the center of the mesh bounds and scaled
+ * uniformly, so that the longest half of the bounds takes the whole short
+ * range. Uniform scale keeps normals valid under the modelview matrix that
+ * maps positions back. Texture coordinates are packed the same way by their
+ * own bounds.
+ *
+ * Vertex and index bytes of the mesh before and after packing are kept in
+ * vertexBytesBefore, vertexBytesAfter, indexBytesBefore and indexBytesAfter.
+ */
+void cObj2OGL::packMesh()
+{
+    float texMin[2] = {0.0, 0.0};
+    float texMax[2] = {0.0, 0.0};
+    for(int i = 0; i < nMeshVertices; i++)
+    {
+        const sVertex &v = meshVertexData[i];
+        if(i == 0 || v.s < texMin[0]) texMin[0] = v.s;
+        if(i == 0 || v.t < texMin[1]) texMin[1] = v.t;
+        if(i == 0 || v.s > texMax[0]) texMax[0] = v.s;
+        if(i == 0 || v.t > texMax[1]) texMax[1] = v.t;
+    }
+
+    float half = qMax(qMax(meshMax.x - meshMin.x, meshMax.y - meshMin.y),
+                      meshMax.z - meshMin.z) / 2.0;
+    float texHalf = qMax(texMax[0] - texMin[0], texMax[1] - texMin[1]) / 2.0;
+
+    meshPacking.offset[0] = (meshMin.x + meshMax.x) / 2.0;
+    meshPacking.offset[1] = (meshMin.y + meshMax.y) / 2.0;
+    meshPacking.offset[2] = (meshMin.z + meshMax.z) / 2.0;
+    meshPacking.scale = half > 0.0 ? half / 32767.0 : 1.0;
+    meshPacking.texOffset[0] = (texMin[0] + texMax[0]) / 2.0;
+    meshPacking.texOffset[1] = (texMin[1] + texMax[1]) / 2.0;
+    meshPacking.texScale = texHalf > 0.0 ? texHalf / 32767.0 : 1.0;
+
+    meshPackedVertices.resize(nMeshVertices);
+    for(int i = 0; i < nMeshVertices; i++)
+        packVertex(meshVertexData[i], meshPacking, meshPackedVertices[i]);
+    meshPackedData = meshPackedVertices.constData();
+
+    // indices are uploaded as GLushort when they fit, see cUfo::makeBuffers()
+    vertexBytesBefore = (qint64) nMeshVertices*sizeof(sVertex);
+    vertexBytesAfter = (qint64) nMeshVertices*sizeof(sPackedVertex);
+    indexBytesBefore = (qint64) nMeshIndices*sizeof(GLuint);
+    indexBytesAfter = (qint64) nMeshIndices*(nMeshVertices <= 65536 ?
+                                             sizeof(GLushort) :
+                                             sizeof(GLuint));
+}
+
+// size of the modelled vertex cache, see cObj2OGL::optimizeMesh(), ACMR is
+// measured with a cache of the same size
+static const int vertexCacheSize = 32;
+
+/*!
+ * \brief Average cache miss ratio of triangle list.
+ *
+ * Number of vertices transformed per triangle with a FIFO post-transform
+ * cache of cacheSize entries. Vertex is in the cache when fewer than
+ * cacheSize misses happened since it was loaded. Best possible value is
+ * about 0.5, 3.0 means no reuse at all.
+ */
+static float averageCacheMissRatio(const QVector<GLuint> &indices,
+                                   int nVertices, int cacheSize)
+{
+    if(indices.isEmpty()) return 0.0;
+
+    QVector<int> loaded(nVertices, -cacheSize - 1);
+    int misses = 0;
+    for(int i = 0; i < indices.size(); i++)
+    {
+        int v = indices.at(i);
+        if(misses - loaded.at(v) > cacheSize)
+        {
+            loaded[v] = misses;
+            misses++;
+        }
+    }
+    return misses / (float) (indices.size()/3);
+}
+
+/*!
+ * \brief Reorders triangles and vertices of the mesh for the GPU caches.
+ *
+ * Triangles are reordered by Tom Forsyth's linear-speed vertex cache
+ * optimisation. Every vertex has a score given by its position in a modelled
+ * LRU cache and by the number of triangles still using it. Triangle with the
+ * highest sum of vertex scores is emitted next, only triangles of vertices
+ * whose score changed are scored again. When none of them is left, the next
+ * triangle not emitted yet is taken.
+ *
+ * Vertices are then renumbered in order of their first use, so the vertex
+ * fetch walks meshVertices mostly forward.
+ *
+ * Average cache miss ratio before and after, with a FIFO cache of
+ * vertexCacheSize entries, is kept in acmrBefore and acmrAfter.
+ */
+void cObj2OGL::optimizeMesh()
+{
+    int nVerts = meshVertices.size();
+    int nTris = meshIndices.size()/3;
+    acmrBefore = averageCacheMissRatio(meshIndices, nVerts, vertexCacheSize);
+    if(nTris == 0)
+    {
+        acmrAfter = acmrBefore;
+        return;
+    }
+
+    // scores of cache positions and of numbers of remaining triangles
+    float cacheScore[vertexCacheSize];
+    for(int i = 0; i < vertexCacheSize; i++)
+    {
+        if(i < 3) // vertices of the last triangle
+            cacheScore[i] = 0.75;
+        else
+            cacheScore[i] = pow(1.0 - (i - 3) / (double) (vertexCacheSize - 3),
+                                1.5);
+    }
+    const int maxValence = 64;
+    float valenceScore[maxValence];
+    for(int i = 1; i < maxValence; i++)
+        valenceScore[i] = 2.0 * pow((double) i, -0.5);
+
+    // triangles using every vertex, triangles of vertex v are
+    // vertexTris[trisOffset[v]] ... vertexTris[trisOffset[v] + remaining[v]]
+    QVector<int> remaining(nVerts, 0);
+    QVector<int> trisOffset(nVerts + 1, 0);
+    QVector<int> vertexTris(3*nTris);
+    for(int i = 0; i < 3*nTris; i++)
+        remaining[meshIndices.at(i)]++;
+    for(int v = 0; v < nVerts; v++)
+        trisOffset[v+1] = trisOffset[v] + remaining[v];
+    QVector<int> fill(trisOffset);
+    for(int i = 0; i < 3*nTris; i++)
+        vertexTris[fill[meshIndices.at(i)]++] = i/3;
+
+    QVector<int> cachePos(nVerts, -1);
+    QVector<float> vertScore(nVerts);
+    for(int v = 0; v < nVerts; v++)
+    {
+        int r = remaining.at(v);
+        vertScore[v] = (r > 0) ? valenceScore[qMin(r, maxValence - 1)] : -1.0;
+    }
+
+    QVector<float> triScore(nTris);
+    QVector<bool> emitted(nTris, false);
+    int best = 0;
+    for(int t = 0; t < nTris; t++)
+    {
+        triScore[t] = vertScore.at(meshIndices.at(3*t)) +
+                      vertScore.at(meshIndices.at(3*t+1)) +
+                      vertScore.at(meshIndices.at(3*t+2));
+        if(triScore.at(t) > triScore.at(best))
+            best = t;
+    }
+
+    int cache[vertexCacheSize + 3];
+    int cacheCount = 0;
+    int nextFree = 0; // no triangle before it is waiting
+    QVector<GLuint> order;
+    order.reserve(3*nTris);
+    for(int n = 0; n < nTris; n++)
+    {
+        if(best < 0)
+        {
+            while(emitted.at(nextFree)) nextFree++;
+            best = nextFree;
+        }
+
+        emitted[best] = true;
+        int tv[3];
+        for(int k = 0; k < 3; k++)
+        {
+            tv[k] = meshIndices.at(3*best + k);
+            order.append(tv[k]);
+
+            // remove the triangle from triangles of its vertices
+            int *tris = vertexTris.data() + trisOffset.at(tv[k]);
+            int r = --remaining[tv[k]];
+            for(int j = 0; j <= r; j++)
+            {
+                if(tris[j] == best)
+                {
+                    tris[j] = tris[r];
+                    break;
+                }
+            }
+        }
+
+        // vertices of the triangle go to the front of the cache
+        int newCache[vertexCacheSize + 3];
+        int newCount = 0;
+        for(int k = 0; k < 3; k++)
+        {
+            if(newCount > 0 && (newCache[0] == tv[k] ||
+                                (newCount > 1 && newCache[1] == tv[k])))
+                continue;
+            newCache[newCount++] = tv[k];
+        }
+        for(int i = 0; i < cacheCount; i++)
+        {
+            int v = cache[i];
+            if(v != tv[0] && v != tv[1] && v != tv[2])
+                newCache[newCount++] = v;
+        }
+
+        // scores of vertices in the cache and of those pushed out of it
+        best = -1;
+        float bestScore = -1.0;
+        for(int i = 0; i < newCount; i++)
+        {
+            int v = newCache[i];
+            cachePos[v] = (i < vertexCacheSize) ? i : -1;
+            int r = remaining.at(v);
+            float score = -1.0;
+            if(r > 0)
+            {
+                score = valenceScore[qMin(r, maxValence - 1)];
+                if(i < vertexCacheSize)
+                    score += cacheScore[i];
+            }
+            vertScore[v] = score;
+        }
+        for(int i = 0; i < newCount; i++)
+        {
+            int v = newCache[i];
+            const int *tris = vertexTris.constData() + trisOffset.at(v);
+            for(int j = 0; j < remaining.at(v); j++)
+            {
+                int t = tris[j];
+                float score = vertScore.at(meshIndices.at(3*t)) +
+                              vertScore.at(meshIndices.at(3*t+1)) +
+                              vertScore.at(meshIndices.at(3*t+2));
+                triScore[t] = score;
+                if(score > bestScore)
+                {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+
+        cacheCount = qMin(newCount, vertexCacheSize);
+        for(int i = 0; i < cacheCount; i++)
+            cache[i] = newCache[i];
+    }
+
+    // renumber vertices in order of their first use
+    QVector<int> remap(nVerts, -1);
+    QVector<sVertex> reordered;
+    reordered.reserve(nVerts);
+    for(int i = 0; i < order.size(); i++)
+    {
+        int v = order.at(i);
+        if(remap.at(v) < 0)
+        {
+            remap[v] = reordered.size();
+            reordered.append(meshVertices.at(v));
+        }
+        order[i] = remap.at(v);
+    }
+
+    meshVertices = reordered;
+    meshIndices = order;
+    acmrAfter = averageCacheMissRatio(meshIndices, meshVertices.size(),
+                                      vertexCacheSize);
+}
+
+/*!
+ * \brief Prints statistics of the built mesh.
+ *
+ * Called by the loader of cMeshCache when WH_STATS is defined (qmake
+ * CONFIG+=stats). Mesh mapped from the mesh cache was not built this run,
+ * its statistics are not known.
+ */
+void cObj2OGL::printStats() const
+{
+    QByteArray name = objFileName.toLocal8Bit();
+    int nTriangles = meshLodOffsets.size() > 1 ? meshLodOffsets.at(1)/3
+                                               : nMeshIndices/3;
+    qDebug("cObj2OGL: %s: %d vertices, %d triangles", name.constData(),
+           nMeshVertices, nTriangles);
+
+    QString counts;
+    for(int i = 0; i+1 < meshLodOffsets.size(); i++)
+        counts += QString(" %1").arg((meshLodOffsets[i+1] -
+                                      meshLodOffsets[i])/3);
+    qDebug("cObj2OGL: %s: LOD triangles%s", name.constData(),
+           counts.toLatin1().constData());
+    if(bMeshCached)
+    {
+        qDebug("cObj2OGL: %s: mapped from mesh cache", name.constData());
+        return;
+    }
+
+    qDebug("cObj2OGL: %s: %.1f bytes per parsed face", name.constData(),
+           bytesPerFace);
+    if(bOptimizeMesh)
+        qDebug("cObj2OGL: %s: ACMR %.3f -> %.3f", name.constData(),
+               acmrBefore, acmrAfter);
+    if(lodEdges > 0)
+        qDebug("cObj2OGL: %s: %d of %d edges are open", name.constData(),
+               lodOpenEdges, lodEdges);
+    if(bPackVertices)
+        qDebug("cObj2OGL: %s: vertices %lld -> %lld bytes, "
+               "indices %lld -> %lld bytes", name.constData(),
+               vertexBytesBefore, vertexBytesAfter,
+               indexBytesBefore, indexBytesAfter);
+}
+
+/*!
+ * \brief Builds a small dart shaped mesh.
+ *
+ * Mesh drawn in place of a model that is not loaded yet. The dart points to
+ * -z, its half width is size. Faces are flat shaded, so no vertices are
+ * shared.
+ */
+void cObj2OGL::makePlaceholderMesh(float size)
+{
+    static const float points[4][3] = {
+        { 0.0, 0.0, -1.5}, // nose
+        {-1.0, 0.0,  1.0}, // left wing
+        { 1.0, 0.0,  1.0}, // right wing
+        { 0.0, 0.4,  0.5}  // top
+    };
+    static const int triangles[4][3] = {
+        {0, 3, 1}, {0, 2, 3}, {0, 1, 2}, {1, 3, 2}
+    };
+
+    freeMemory();
+    meshVertices.clear();
+    meshPackedVertices.clear();
+    meshIndices.clear();
+
+    for(int i = 0; i < 4; i++)
+    {
+        const float *p0 = points[triangles[i][0]];
+        const float *p1 = points[triangles[i][1]];
+        const float *p2 = points[triangles[i][2]];
+        float dx1 = p1[0] - p0[0];
+        float dy1 = p1[1] - p0[1];
+        float dz1 = p1[2] - p0[2];
+        float dx2 = p2[0] - p0[0];
+        float dy2 = p2[1] - p0[1];
+        float dz2 = p2[2] - p0[2];
+        float nx = dy1*dz2 - dz1*dy2;
+        float ny = dz1*dx2 - dx1*dz2;
+        float nz = dx1*dy2 - dy1*dx2;
+        float d = sqrt(nx*nx + ny*ny + nz*nz);
+
+        for(int k = 0; k < 3; k++)
+        {
+            const float *p = points[triangles[i][k]];
+            sVertex v;
+            v.x = p[0]*size;
+            v.y = p[1]*size;
+            v.z = p[2]*size;
+            v.nx = nx/d;
+            v.ny = ny/d;
+            v.nz = nz/d;
+            v.s = 0.0;
+            v.t = 0.0;
+            meshIndices.append(meshVertices.size());
+            meshVertices.append(v);
+        }
+    }
+
+    meshVertexData = meshVertices.constData();
+    meshPackedData = NULL;
+    meshIndexData = meshIndices.constData();
+    nMeshVertices = meshVertices.size();
+    nMeshIndices = meshIndices.size();
+    meshLodOffsets.clear();
+    meshLodOffsets.append(0);
+    meshLodOffsets.append(nMeshIndices);
+    meshMin.x = -size;
+    meshMin.y = 0.0;
+    meshMin.z = -1.5*size;
+    meshMax.x = size;
+    meshMax.y = 0.4*size;
+    meshMax.z = size;
+    buildHull();
+}
+
+// version of the mesh cache layout, caches of other versions are rebuilt
+static const quint32 meshCacheVersion = 6;
+
+// bytes of source obj file hashed to validate mesh cache, see objSampleHash()
+static const qint64 objHashSample = 64*1024;
+static const int objHashSamples = 16;
+
+/*!
+ * \brief Header of mesh cache file.
+ *
+ * Header is followed by nVertices of sVertex (or sPackedVertex, when packing
+ * is set) padded to whole GLuints and nIndices of GLuint (of all LODs), all in
+ * native byte order.
+ * Cache is valid while its source obj file has the same size, modification
+ * time and hash of samples.
+ */
+struct sMeshCacheHeader {
+    char magic[4];          // "WHMC"
+    quint32 version;        // meshCacheVersion
+    quint32 vertexSize;     // sizeof(sVertex) or sizeof(sPackedVertex)
+    quint32 bOptimized;     // mesh was reordered by optimizeMesh()
+    quint32 normalWeighting; // of normals made by generateNormals()
+    quint32 bLods;          // LODs were made by buildLods()
+    quint32 nVertices;
+    quint32 nIndices;
+    qint64 sourceSize;
+    qint64 sourceTime;      // seconds since epoch
+    char sourceHash[20];    // see objSampleHash()
+    float boundsMin[3];
+    float boundsMax[3];
+    sVertexPacking packing; // of sPackedVertex
+    quint32 nLods;
+    quint32 lodOffsets[maxMeshLods + 1]; // see cObj2OGL::meshLodOffsets
+    quint32 nHull;
+    float hull[hullDirections][3]; // see cObj2OGL::meshHull
+};
+
+// mesh cache is stored next to the obj file
+static QString meshCachePath(QString str)
+{
+    return str + QString(".cache");
+}
+
+// vertices of mesh cache are padded, so its indices stay aligned
+static qint64 meshCacheVertexBytes(quint32 nVertices, quint32 vertexSize)
+{
+    qint64 bytes = (qint64) nVertices*vertexSize;
+    return (bytes + sizeof(GLuint) - 1) / sizeof(GLuint) * sizeof(GLuint);
+}
+
+/*!
+ * \brief Checks mesh of cache before anything is drawn from it.
+ *
+ * LOD offsets have to start at 0 and not descend, by whole triangles, up to
+ * nIndices, every index has to refer to a vertex of the cache. Size of the
+ * cache file is checked already.
+ */
+static bool meshCacheConsistent(const sMeshCacheHeader *header,
+                                const GLuint *indices)
+{
+    if(header->nIndices % 3 != 0 || header->lodOffsets[0] != 0)
+        return false;
+    for(quint32 i = 0; i < header->nLods; i++)
+        if(header->lodOffsets[i] > header->lodOffsets[i+1] ||
+           header->lodOffsets[i+1] % 3 != 0)
+            return false;
+
+    for(quint32 i = 0; i < header->nIndices; i++)
+        if(indices[i] >= header->nVertices)
+            return false;
+    return true;
+}
+
+/*!
+ * \brief Hash of obj file samples.
+ *
+ * Small files are hashed whole, bigger ones by objHashSamples samples spread
+ * evenly over the file, so validating cache reads at most 1 MB.
+ *
+ * \return SHA-1 of samples, empty if the file can not be read.
+ */
+static QByteArray objSampleHash(QString str)
+{
+    QFile objFile(str);
+    if(!objFile.open(QIODevice::ReadOnly)) return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    qint64 size = objFile.size();
+    if(size <= objHashSample*objHashSamples)
+    {
+        hash.addData(objFile.readAll());
+    } else
+    {
+        qint64 step = (size - objHashSample)/(objHashSamples - 1);
+        for(int i = 0; i < objHashSamples; i++)
+        {
+            objFile.seek(i*step);
+            hash.addData(objFile.read(objHashSample));
+        }
+    }
+    objFile.close();
+
+    QByteArray result = hash.result();
+    result.resize(20);
+    return result;
+}
+
+/*!
+ * \brief Maps mesh of obj file str from its cache.
+ *
+ * Cache file is mapped to memory, meshIndexData and meshVertexData (or
+ * meshPackedData, if bPackVertices is set) point right into it. Cache that
+ * does not match the obj file, or whose LODs or indices do not fit its
+ * vertices, is left alone, it will be overwritten by cObj2OGL::buildMesh().
+ *
+ * \return true if the mesh is ready to be drawn.
+ */
+bool cObj2OGL::loadMeshCache(QString str)
+{
+    freeMemory();
+
+    QFileInfo source(str);
+    if(!source.exists()) return false;
+
+    meshCacheFile.setFileName(meshCachePath(str));
+    if(!meshCacheFile.open(QIODevice::ReadOnly)) return false;
+
+    qint64 size = meshCacheFile.size();
+    if(size >= (qint64) sizeof(sMeshCacheHeader))
+        meshCacheMap = meshCacheFile.map(0, size);
+    if(meshCacheMap == NULL)
+    {
+        meshCacheFile.close();
+        return false;
+    }
+
+    quint32 vertexSize = bPackVertices ? sizeof(sPackedVertex)
+                                       : sizeof(sVertex);
+    const sMeshCacheHeader *header = (const sMeshCacheHeader *) meshCacheMap;
+    bool bValid = memcmp(header->magic, "WHMC", 4) == 0 &&
+                  header->version == meshCacheVersion &&
+                  header->vertexSize == vertexSize &&
+                  header->bOptimized == (quint32) bOptimizeMesh &&
+                  header->normalWeighting == (quint32) normalWeighting &&
+                  header->bLods == (quint32) bBuildLods &&
+                  header->nLods >= 1 && header->nLods <= maxMeshLods &&
+                  header->lodOffsets[header->nLods] == header->nIndices &&
+                  header->nHull <= (quint32) hullDirections &&
+                  size == (qint64) sizeof(sMeshCacheHeader) +
+                          meshCacheVertexBytes(header->nVertices,
+                                               vertexSize) +
+                          (qint64) header->nIndices*sizeof(GLuint) &&
+                  header->sourceSize == source.size() &&
+                  header->sourceTime ==
+                      (qint64) source.lastModified().toTime_t();
+    const uchar *vertexData = meshCacheMap + sizeof(sMeshCacheHeader);
+    if(bValid)
+        bValid = QByteArray(header->sourceHash, 20) == objSampleHash(str);
+    if(bValid)
+        bValid = meshCacheConsistent(header, (const GLuint *) (vertexData +
+                                     meshCacheVertexBytes(header->nVertices,
+                                                          vertexSize)));
+    if(!bValid)
+    {
+        closeMeshCache();
+        return false;
+    }
+
+    if(bPackVertices)
+    {
+        meshPackedData = (const sPackedVertex *) vertexData;
+        meshPacking = header->packing;
+    } else
+        meshVertexData = (const sVertex *) vertexData;
+    meshIndexData = (const GLuint *) (vertexData +
+                                      meshCacheVertexBytes(header->nVertices,
+                                                           vertexSize));
+    nMeshVertices = header->nVertices;
+    nMeshIndices = header->nIndices;
+    meshLodOffsets.clear();
+    for(quint32 i = 0; i <= header->nLods; i++)
+        meshLodOffsets.append(header->lodOffsets[i]);
+    meshMin.x = header->boundsMin[0];
+    meshMin.y = header->boundsMin[1];
+    meshMin.z = header->boundsMin[2];
+    meshMax.x = header->boundsMax[0];
+    meshMax.y = header->boundsMax[1];
+    meshMax.z = header->boundsMax[2];
+    meshHull.resize(header->nHull);
+    for(quint32 i = 0; i < header->nHull; i++)
+    {
+        meshHull[i].x = header->hull[i][0];
+        meshHull[i].y = header->hull[i][1];
+        meshHull[i].z = header->hull[i][2];
+    }
+    bMeshCached = true;
+
+    return true;
+}
+
+/*!
+ * \brief Writes built mesh to the cache of objFileName.
+ *
+ * Cache is written to a temporary file first and renamed, so a broken write
+ * never leaves a cache that looks valid. Failing to write the cache (e.g. in
+ * a read only directory) is not an error, the obj file is parsed next time.
+ */
+void cObj2OGL::saveMeshCache()
+{
+    if(objFileName.isEmpty()) return;
+
+    QFileInfo source(objFileName);
+    QByteArray hash = objSampleHash(objFileName);
+    if(hash.isEmpty()) return;
+
+    sMeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "WHMC", 4);
+    header.version = meshCacheVersion;
+    header.vertexSize = meshPackedData ? sizeof(sPackedVertex)
+                                       : sizeof(sVertex);
+    header.bOptimized = bOptimizeMesh;
+    header.normalWeighting = normalWeighting;
+    header.bLods = bBuildLods;
+    header.nLods = meshLodOffsets.size() - 1;
+    for(int i = 0; i < meshLodOffsets.size(); i++)
+        header.lodOffsets[i] = meshLodOffsets.at(i);
+    header.nVertices = nMeshVertices;
+    header.nIndices = nMeshIndices;
+    header.sourceSize = source.size();
+    header.sourceTime = source.lastModified().toTime_t();
+    memcpy(header.sourceHash, hash.constData(), 20);
+    header.boundsMin[0] = meshMin.x;
+    header.boundsMin[1] = meshMin.y;
+    header.boundsMin[2] = meshMin.z;
+    header.boundsMax[0] = meshMax.x;
+    header.boundsMax[1] = meshMax.y;
+    header.boundsMax[2] = meshMax.z;
+    if(meshPackedData)
+        header.packing = meshPacking;
+    header.nHull = meshHull.size();
+    for(int i = 0; i < meshHull.size(); i++)
+    {
+        header.hull[i][0] = meshHull.at(i).x;
+        header.hull[i][1] = meshHull.at(i).y;
+        header.hull[i][2] = meshHull.at(i).z;
+    }
+
+    QString path = meshCachePath(objFileName);
+    QFile cacheFile(path + QString(".tmp"));
+    if(!cacheFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) return;
+
+    const char *vertexData = meshPackedData ? (const char *) meshPackedData
+                                            : (const char *) meshVertexData;
+    qint64 vertexBytes = (qint64) nMeshVertices*header.vertexSize;
+    qint64 paddingBytes = meshCacheVertexBytes(nMeshVertices,
+                                               header.vertexSize) - vertexBytes;
+    qint64 indexBytes = (qint64) nMeshIndices*sizeof(GLuint);
+    const char padding[sizeof(GLuint)] = {0};
+    bool bWritten =
+        cacheFile.write((const char *) &header, sizeof(header)) ==
+            (qint64) sizeof(header) &&
+        cacheFile.write(vertexData, vertexBytes) ==
+            vertexBytes &&
+        cacheFile.write(padding, paddingBytes) ==
+            paddingBytes &&
+        cacheFile.write((const char *) meshIndexData, indexBytes) ==
+            indexBytes;
+    cacheFile.close();
+
+    QFile::remove(path);
+    if(!bWritten || !QFile::rename(cacheFile.fileName(), path))
+        QFile::remove(cacheFile.fileName());
+}
+
+/*!
+ * \brief Unmaps mesh cache.
+ *
+ * Mesh taken from the cache is gone too.
+ */
+void cObj2OGL::closeMeshCache()
+{
+    if(meshCacheMap != NULL)
+        meshCacheFile.unmap(meshCacheMap);
+    meshCacheFile.close();
+    meshCacheMap = NULL;
+
+    if(bMeshCached)
+    {
+        bMeshCached = false;
+        meshVertexData = NULL;
+        meshPackedData = NULL;
+        meshIndexData = NULL;
+        nMeshVertices = 0;
+        nMeshIndices = 0;
+        meshLodOffsets.clear();
+        meshHull.clear();
+    }
 }
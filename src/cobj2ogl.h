@@ -10,9 +10,14 @@
 #ifndef COBJ2OGL_H
 #define COBJ2OGL_H
 
+#include "myinclude.h"
+
 #include <QGLWidget>
 #include <QFile>
 #include <QProgressDialog>
+#include <QHash>
+#include <QVector>
+#include <QAtomicInt>
 
 struct sFace {
     int vertIndex;
@@ -20,16 +25,36 @@ struct sFace {
     int normIndex;
 };
 
+// face corners are welded by all three indices (see cObj2OGL::buildMesh())
+inline bool operator==(const sFace &a, const sFace &b)
+{
+    return a.vertIndex == b.vertIndex && a.textIndex == b.textIndex &&
+           a.normIndex == b.normIndex;
+}
+
+inline uint qHash(const sFace &face)
+{
+    return (uint) face.vertIndex * 73856093u ^
+           (uint) face.textIndex * 19349663u ^
+           (uint) face.normIndex * 83492791u;
+}
+
 /*!
  * \class cObj2OGL
  * \brief Obj file parser.
  *
  * This class offeres methods that read obj fles. It converts obj to OpenGL
- * applicable commands, creating display list in this process.
+ * applicable data, an indexed triangle mesh ready for vertex buffers.
  */
 class cObj2OGL
 {
 public:
+    // how faces contribute to normals made by generateNormals()
+    enum eNormalWeighting {
+        AreaWeighting,  // by area of the face
+        AngleWeighting  // by angle of the face at the vertex
+    };
+
     cObj2OGL();
     ~cObj2OGL();
     void freeMemory();
@@ -37,19 +62,73 @@ public:
     int makeObjectFromObjFileWithNormals(QString str,
                                          QProgressBar * progress_bar,
                                          QLabel * progress_label);
-    sPoint3 computeFaceNormal(int index0, int index1, int index2);
-    void normalizeVertexNormals();
-    GLuint createDisplayList();
+    bool buildMesh();
+    void generateNormals();
+    void optimizeMesh();
+    void buildLods();
+    void buildHull();
+    void packMesh();
+    void makePlaceholderMesh(float size);
+    void printStats() const;
 
     int numVertices;
     int numTextures;
     int numNormals;
     int numFaces;
-    sPoint3 * vertices;
-    sPoint3 * textures;
-    sPoint3 * normals;
-    QList<sFace> * faces;
+    QVector<sPoint3> vertices;
+    QVector<sPoint3> textures;
+    QVector<sPoint3> normals;
+    QVector<sFace> faceCorners;    // corners of all faces, face after face
+    QVector<int> faceOffsets;      // face i has corners faceOffsets[i] ...
+                                   // faceOffsets[i+1]-1 of faceCorners
     bool bParsed;
+    float bytesPerFace;            // of faceCorners and faceOffsets
+
+    QVector<sVertex> meshVertices; // welded vertices, see buildMesh()
+    QVector<GLuint> meshIndices;   // 3 indices into meshVertices per triangle
+                                   // of every LOD
+    bool bOptimizeMesh;            // reorder mesh for vertex cache
+    eNormalWeighting normalWeighting;
+    bool bBuildLods;               // add simplified LODs, see buildLods()
+    QVector<int> meshLodOffsets;   // LOD i is meshIndices meshLodOffsets[i]
+                                   // ... meshLodOffsets[i+1]-1, 0 is full
+    int lodEdges;                  // edges of the mesh and open ones among
+    int lodOpenEdges;              // them, see buildLods()
+    float acmrBefore;              // average cache miss ratio, see
+    float acmrAfter;               // cObj2OGL::optimizeMesh()
+    bool bPackVertices;            // build and cache sPackedVertex mesh
+    qint64 vertexBytesBefore;      // size of the mesh before and after
+    qint64 vertexBytesAfter;       // cObj2OGL::packMesh()
+    qint64 indexBytesBefore;
+    qint64 indexBytesAfter;
+    QVector<sPackedVertex> meshPackedVertices; // see packMesh()
+    sVertexPacking meshPacking;
+
+    QString objFileName;           // obj file of the mesh cache
+    bool bMeshCached;              // mesh is mapped from the mesh cache
+    const sVertex * meshVertexData; // meshVertices or mapped mesh cache
+    const sPackedVertex * meshPackedData; // packed vertices, if any
+    const GLuint * meshIndexData;  // meshIndices or mapped mesh cache
+    int nMeshVertices;
+    int nMeshIndices;
+    sPoint3 meshMin;               // bounding box of the mesh
+    sPoint3 meshMax;
+    QVector<sPoint3> meshHull;     // points of convex hull, see buildHull()
+
+    QAtomicInt progress;           // of parsing, 0 - 100
+
+private:
+    bool loadMeshCache(QString str);
+    void saveMeshCache();
+    void closeMeshCache();
+    bool parseObjFile(QString str, bool bWithNormals,
+                      QProgressBar * progress_bar);
+    void parseObjParallel(const char *data, qint64 size, bool bWithNormals,
+                          QProgressBar * progress_bar,
+                          qint64 offset, qint64 total);
+
+    QFile meshCacheFile;
+    uchar * meshCacheMap;
 
 };
 
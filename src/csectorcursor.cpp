@@ -0,0 +1,90 @@
+/*!
+ * \file csectorcursor.cpp
+ *
+ * \author David Smejkal
+ * \date 17.10.2026
+ *
+ * Wormhole sector lookup for collision detection definition.
+ */
+
+#include "csectorcursor.h"
+#include "cwormhole.h"
+
+// cursor is looked up anew when it would walk further than this
+static const int maxCursorSteps = 8;
+
+/*!
+ * \brief Constructor of cSectorCursor.
+ */
+cSectorCursor::cSectorCursor()
+{
+    reset();
+}
+
+/*!
+ * \brief Forgets the last sector, next cSectorCursor::find() looks it up.
+ */
+void cSectorCursor::reset()
+{
+    bValid = false;
+    generation = 0;
+    sector = 0;
+}
+
+/*!
+ * \brief Finds sector j, 1 <= j < whSectors-1, that encloses point p.
+ *
+ * Point p lies between planes of spline points j-1 and j, see
+ * cWormhole::sectorParam().
+ *
+ * \return sector of the front store, -1 if p is outside of the wormhole.
+ */
+int cSectorCursor::find(cWormhole *wormhole, const sPoint3 &p)
+{
+    int j = locate(wormhole, p);
+
+    float s = wormhole->sectorParam(j, p);
+    if(!(0.0 <= s && s < 1.0))
+        return -1;
+    return j;
+}
+
+/*!
+ * \brief Finds sector j, 1 <= j < whSectors-1, of point p.
+ *
+ * Walks from the sector found last time while p lies beyond plane of spline
+ * point j (forward) or before plane of spline point j-1 (backward), at most
+ * maxCursorSteps sectors. The first or the last sector is returned when p is
+ * outside of the wormhole, the sector closest to p when it is far from the
+ * last one or the wormhole was recreated. It is remembered for the next call.
+ */
+int cSectorCursor::locate(cWormhole *wormhole, const sPoint3 &p)
+{
+    int last = wormhole->whSectors - 2;
+    int j = sector - wormhole->front->shiftedSectors;
+
+    if(!bValid || generation != wormhole->generation || j < 1 || j > last)
+        j = wormhole->nearestSector(p);
+    else
+    {
+        for(int steps = 0; ; steps++)
+        {
+            float s = wormhole->sectorParam(j, p);
+            bool bForward = s >= 1.0 && j < last;
+            bool bBackward = s < 0.0 && j > 1;
+            if(!bForward && !bBackward)
+                break;
+            if(steps == maxCursorSteps)
+            {
+                j = wormhole->nearestSector(p);
+                break;
+            }
+            j += bForward ? 1 : -1;
+        }
+    }
+
+    bValid = true;
+    generation = wormhole->generation;
+    sector = wormhole->front->shiftedSectors + j;
+    return j;
+}
@@ -0,0 +1,46 @@
+/*!
+ * \file csectorcursor.h
+ *
+ * \author David Smejkal
+ * \date 17.10.2026
+ *
+ * Wormhole sector lookup for collision detection declaration.
+ */
+
+#ifndef CSECTORCURSOR_H
+#define CSECTORCURSOR_H
+
+#include "myinclude.h"
+
+class cWormhole;
+
+/*!
+ * \class cSectorCursor
+ * \brief Finds wormhole sector the ship is in, starting where it was last.
+ *
+ * Ship moves only a little between two collision checks, so the sector found
+ * last time is checked first and the cursor walks a few sectors forward or
+ * backward from it. When the sector is too far (ship was reset, wormhole was
+ * recreated) it is looked up in cSectorTree. Sectors are parted by planes of
+ * their spline points (see cWormhole::planeDistance()), so the cursor works
+ * for winding wormhole too. It follows sectors through shifts of the
+ * wormhole ring, see sSectorStore::shiftedSectors, and forgets them when the
+ * wormhole is recreated, see cWormhole::generation.
+ */
+class cSectorCursor
+{
+public:
+    cSectorCursor();
+
+    int find(cWormhole *wormhole, const sPoint3 &p);
+    int locate(cWormhole *wormhole, const sPoint3 &p);
+    void reset();
+
+private:
+    bool bValid;
+    int generation; // cWormhole::generation of the sector found last time
+    int sector; // sSectorStore::shiftedSectors + sector found last time
+};
+
+
+#endif // CSECTORCURSOR_H
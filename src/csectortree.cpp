@@ -0,0 +1,265 @@
+/*!
+ * \file csectortree.cpp
+ *
+ * \author David Smejkal
+ * \date 17.10.2026
+ *
+ * Bounding volume hierarchy over wormhole sectors definition.
+ */
+
+#include "csectortree.h"
+#include "cwormhole.h"
+
+// depth of the tree is at most log2 of the number of ring slots
+static const int maxTreeStack = 64;
+
+/*!
+ * \brief Squared distance of point p from segment a-b.
+ */
+static float segmentDistance2(const sPoint3 &a, const sPoint3 &b,
+                              const sPoint3 &p)
+{
+    float dx = b.x - a.x, dy = b.y - a.y, dz = b.z - a.z;
+    float px = p.x - a.x, py = p.y - a.y, pz = p.z - a.z;
+    float len2 = dx*dx + dy*dy + dz*dz;
+    float s = len2 > 0.0 ? (px*dx + py*dy + pz*dz)/len2 : 0.0;
+    s = qBound(0.0f, s, 1.0f);
+    px -= s*dx;
+    py -= s*dy;
+    pz -= s*dz;
+    return px*px + py*py + pz*pz;
+}
+
+/*!
+ * \brief Constructor of cSectorTree.
+ */
+cSectorTree::cSectorTree()
+{
+    nLeaves = 0;
+}
+
+/*!
+ * \brief Builds the tree over all sectors of store.
+ */
+void cSectorTree::build(sSectorStore &store)
+{
+    nLeaves = 1;
+    while(nLeaves < store.whSectors)
+        nLeaves *= 2;
+    nodes.resize(2*nLeaves);
+
+    for(int i = 0; i < nLeaves; i++)
+    {
+        sBox &box = nodes[nLeaves + i];
+        for(int k = 0; k < 3; k++)
+        {
+            box.min[k] = 1.0;
+            box.max[k] = -1.0;
+        }
+    }
+    for(int i = 0; i < store.whSectors; i++)
+        setLeaf(store, i);
+    for(int node = nLeaves - 1; node >= 1; node--)
+        updateNode(node);
+}
+
+/*!
+ * \brief Refits the tree after sectors first ... last-1 of store changed.
+ *
+ * Sector j depends on spline points j-1 and j, so sector last is refitted
+ * too. Leaves that changed and their parents are updated, each level only
+ * once.
+ */
+void cSectorTree::refit(sSectorStore &store, int first, int last)
+{
+    if(nLeaves < store.whSectors)
+    {
+        build(store);
+        return;
+    }
+
+    first = qMax(first, 0);
+    last = qMin(last + 1, store.whSectors);
+    if(first >= last) return;
+
+    for(int i = first; i < last; i++)
+        setLeaf(store, i);
+
+    // ring slots of the sectors, at most two runs when the ring wraps around
+    int head = store.slot(first);
+    int tail = store.slot(last - 1);
+    int runs[2][2];
+    int nRuns = 1;
+    if(head <= tail)
+    {
+        runs[0][0] = head;
+        runs[0][1] = tail;
+    } else
+    {
+        runs[0][0] = head;
+        runs[0][1] = store.whSectors - 1;
+        runs[1][0] = 0;
+        runs[1][1] = tail;
+        nRuns = 2;
+    }
+
+    for(int r = 0; r < nRuns; r++)
+    {
+        int lo = (nLeaves + runs[r][0])/2;
+        int hi = (nLeaves + runs[r][1])/2;
+        while(lo >= 1)
+        {
+            for(int node = lo; node <= hi; node++)
+                updateNode(node);
+            lo /= 2;
+            hi /= 2;
+        }
+    }
+}
+
+/*!
+ * \brief Sets leaf of sector i, sectors 0 and whSectors-1 have none.
+ *
+ * \sa cSectorCursor
+ */
+void cSectorTree::setLeaf(sSectorStore &store, int i)
+{
+    sBox &box = nodes[nLeaves + store.slot(i)];
+    if(i < 1 || i > store.whSectors - 2)
+    {
+        for(int k = 0; k < 3; k++)
+        {
+            box.min[k] = 1.0;
+            box.max[k] = -1.0;
+        }
+        return;
+    }
+
+    const sPoint3 &a = store.splinePoint(i-1);
+    const sPoint3 &b = store.splinePoint(i);
+    float r = qMax(store.radius(i-1), store.radius(i));
+    box.min[0] = qMin(a.x, b.x) - r;
+    box.min[1] = qMin(a.y, b.y) - r;
+    box.min[2] = qMin(a.z, b.z) - r;
+    box.max[0] = qMax(a.x, b.x) + r;
+    box.max[1] = qMax(a.y, b.y) + r;
+    box.max[2] = qMax(a.z, b.z) + r;
+}
+
+/*!
+ * \brief Box of node is made to bound boxes of its children.
+ */
+void cSectorTree::updateNode(int node)
+{
+    const sBox &a = nodes[2*node];
+    const sBox &b = nodes[2*node + 1];
+    sBox &box = nodes[node];
+    for(int k = 0; k < 3; k++)
+    {
+        box.min[k] = qMin(a.min[k], b.min[k]);
+        box.max[k] = qMax(a.max[k], b.max[k]);
+    }
+    // empty child must not widen the box
+    if(a.min[0] > a.max[0]) box = b;
+    else if(b.min[0] > b.max[0]) box = a;
+}
+
+/*!
+ * \brief Squared distance of point p from box, 0 inside of it.
+ */
+float cSectorTree::boxDistance2(const sBox &box, const sPoint3 &p)
+{
+    float c[3] = {p.x, p.y, p.z};
+    float d2 = 0.0;
+    for(int k = 0; k < 3; k++)
+    {
+        float d = 0.0;
+        if(c[k] < box.min[k]) d = box.min[k] - c[k];
+        else if(c[k] > box.max[k]) d = c[k] - box.max[k];
+        d2 += d*d;
+    }
+    return d2;
+}
+
+/*!
+ * \brief Sector whose axis is the closest to point p.
+ *
+ * Branch and bound, nodes farther than the best sector found are skipped.
+ *
+ * \return sector of store, -1 if the tree is empty.
+ */
+int cSectorTree::nearest(sSectorStore &store, const sPoint3 &p) const
+{
+    if(nLeaves == 0 || nodes[1].min[0] > nodes[1].max[0]) return -1;
+
+    int best = -1;
+    float bestDistance2 = 0.0;
+    int stack[maxTreeStack];
+    int top = 0;
+    stack[top++] = 1;
+    while(top > 0)
+    {
+        int node = stack[--top];
+        const sBox &box = nodes[node];
+        if(box.min[0] > box.max[0]) continue;
+        if(best >= 0 && boxDistance2(box, p) >= bestDistance2) continue;
+
+        if(node >= nLeaves)
+        {
+            int slot = node - nLeaves;
+            int i = (slot - store.firstSector + store.whSectors) %
+                    store.whSectors;
+            float d2 = segmentDistance2(store.splinePoint(i-1),
+                                        store.splinePoint(i), p);
+            if(best < 0 || d2 < bestDistance2)
+            {
+                best = i;
+                bestDistance2 = d2;
+            }
+            continue;
+        }
+
+        // closer child is searched first
+        int a = 2*node, b = 2*node + 1;
+        if(boxDistance2(nodes[a], p) < boxDistance2(nodes[b], p))
+            qSwap(a, b);
+        stack[top++] = a;
+        stack[top++] = b;
+    }
+    return best;
+}
+
+/*!
+ * \brief Appends sectors whose boxes overlap box min-max to sectors.
+ */
+void cSectorTree::overlaps(sSectorStore &store, const sPoint3 &min,
+                           const sPoint3 &max, QVector<int> &sectors) const
+{
+    if(nLeaves == 0) return;
+
+    float lo[3] = {min.x, min.y, min.z};
+    float hi[3] = {max.x, max.y, max.z};
+    int stack[maxTreeStack];
+    int top = 0;
+    stack[top++] = 1;
+    while(top > 0)
+    {
+        int node = stack[--top];
+        const sBox &box = nodes[node];
+        bool bOverlap = box.min[0] <= box.max[0];
+        for(int k = 0; k < 3; k++)
+            if(box.min[k] > hi[k] || box.max[k] < lo[k])
+                bOverlap = false;
+        if(!bOverlap) continue;
+
+        if(node >= nLeaves)
+        {
+            int slot = node - nLeaves;
+            sectors.append((slot - store.firstSector + store.whSectors) %
+                           store.whSectors);
+            continue;
+        }
+        stack[top++] = 2*node;
+        stack[top++] = 2*node + 1;
+    }
+}
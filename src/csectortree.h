@@ -0,0 +1,59 @@
+/*!
+ * \file csectortree.h
+ *
+ * \author David Smejkal
+ * \date 17.10.2026
+ *
+ * Bounding volume hierarchy over wormhole sectors declaration.
+ */
+
+#ifndef CSECTORTREE_H
+#define CSECTORTREE_H
+
+#include "myinclude.h"
+
+#include <QVector>
+
+struct sSectorStore;
+
+/*!
+ * \class cSectorTree
+ * \brief Bounding volume hierarchy over sectors of one sSectorStore.
+ *
+ * Sector j is a capsule around the line between spline points j-1 and j,
+ * as wide as the wider of its ends. Its axis aligned box is a leaf of a
+ * complete binary tree stored in an array (children of node i are 2i and
+ * 2i+1). Leaves are ring slots of the store, not sectors, so shifting the
+ * wormhole only refits leaves of sectors generated again and their parents.
+ * Queries do not depend on the wormhole going along x axis.
+ */
+class cSectorTree
+{
+public:
+    cSectorTree();
+
+    void build(sSectorStore &store);
+    void refit(sSectorStore &store, int first, int last);
+    int nearest(sSectorStore &store, const sPoint3 &p) const;
+    void overlaps(sSectorStore &store, const sPoint3 &min,
+                  const sPoint3 &max, QVector<int> &sectors) const;
+
+private:
+    /*!
+     * \brief Axis aligned box, empty when min > max.
+     */
+    struct sBox {
+        float min[3];
+        float max[3];
+    };
+
+    void setLeaf(sSectorStore &store, int sector);
+    void updateNode(int node);
+    static float boxDistance2(const sBox &box, const sPoint3 &p);
+
+    QVector<sBox> nodes; // node 1 is the root, leaves start at nLeaves
+    int nLeaves;         // power of two
+};
+
+
+#endif // CSECTORTREE_H
@@ -8,31 +8,43 @@
  */
 
 #include "cufo.h"
+#include "cmeshcache.h"
 
 #include <cmath>
 
+// LOD 0 is drawn when ufo is at least this big on screen (radius in pixels),
+// every next LOD when it is half of the previous one
+static const float lodFullDetailPixels = 256.0;
+
 /*!
  * \brief Constructor of cUfo.
  *
  * Just initializing some variables.
  */
-cUfo::cUfo()
+cUfo::cUfo() : indexBuffer(QGLBuffer::IndexBuffer)
 {
-    nLists = 1;
+    nIndices = 0;
+    lod = 0;
+    meshRadius = 0.0;
+    hullRadius = 0.0;
     pos.x = 0.0;
     pos.y = 0.0;
     pos.z = 0.0;
     radius = 0.01;
 }
 
-cUfo::cUfo(QString str) : cGLObject(str)
+cUfo::cUfo(QString str) : cGLObject(str), indexBuffer(QGLBuffer::IndexBuffer)
 {
+    nIndices = 0;
+    lod = 0;
+    meshRadius = 0.0;
+    hullRadius = 0.0;
 }
 
 /*!
  * \brief Destructor of cUfo.
  *
- * Freeing display lists. Important method! Without freeing display lists the
+ * Freeing vertex buffers. Important method! Without freeing vertex buffers the
  * application will loose track of memory that was once used for this object.
  * Since other cUfo object will be created when changin model in settings.
  * Freeing memory whenever it is not needed anymore is not only a good habit,
@@ -40,13 +52,16 @@ cUfo::cUfo(QString str) : cGLObject(str)
  */
 cUfo::~cUfo()
 {
-    glDeleteLists(object, nLists);
+    vertexBuffer.destroy();
+    indexBuffer.destroy();
 }
 
 /*!
- * \brief Creates openGL display list for ufo.
+ * \brief Parses obj file of ufo.
  *
- * Get data from objFile. Use obj2OGL parser.
+ * Get data from objFile. Takes the welded mesh from cMeshCache, parsing it
+ * there first if needed, and blocks until it is done. No GL calls are made.
+ * Progress widgets are not used, see cUfo::loadProgress() instead.
  *
  * \sa cWormhole::makeObject()
  * \note pure virtual method
@@ -54,24 +69,182 @@ cUfo::~cUfo()
 
 void cUfo::makeObject(QProgressBar * progress_bar, QLabel * progress_label)
 {
-    obj2OGL->makeObjectFromObjFileWithNormals(objFile,
-                                              progress_bar,
-                                              progress_label);
+    Q_UNUSED(progress_bar);
+    Q_UNUSED(progress_label);
+
+    startLoading();
+    waitForLoading();
+}
+
+/*!
+ * \brief Makes the placeholder mesh.
+ *
+ * Dart of ufo radius drawn until the real ship is loaded.
+ *
+ * \sa cObj2OGL::makePlaceholderMesh()
+ */
+void cUfo::makePlaceholder()
+{
+    obj2OGL->makePlaceholderMesh(radius);
+}
+
+/*!
+ * \brief Shares mesh of objFile from cMeshCache, loading it in background.
+ *
+ * Poll cUfo::isLoading() and cUfo::loadProgress(), when loading is done
+ * call cUfo::makeBuffers() from the GL thread. Ships preloaded by
+ * cMainWindow are usually done already.
+ */
+void cUfo::startLoading()
+{
+    obj2OGL = cMeshCache::instance()->load(objFile);
+}
+
+/*!
+ * \brief Whether cUfo::startLoading() is still running.
+ */
+bool cUfo::isLoading() const
+{
+    return cMeshCache::instance()->isLoading(objFile);
+}
+
+/*!
+ * \brief Progress of cUfo::startLoading(), 0 - 100.
+ */
+int cUfo::loadProgress() const
+{
+    return obj2OGL->progress;
+}
+
+/*!
+ * \brief Blocks until cUfo::startLoading() is done.
+ */
+void cUfo::waitForLoading()
+{
+    cMeshCache::instance()->waitForLoading(objFile);
+}
+
+/*!
+ * \brief Make vertex buffers of cUfo object.
+ *
+ * Mesh made by cUfo::makeObject() or cUfo::makePlaceholder() is uploaded.
+ * Attention, one of them has to be done before calling this method.
+ * Packed vertices are preferred, indices are uploaded as GLushort when there
+ * are few enough vertices. All LODs go to the same buffers, full mesh is
+ * drawn until cUfo::selectLod() is called. Hull of the mesh is kept for
+ * collisions.
+ *
+ * \sa cWormhole::makeBuffers()
+ * \note pure virtual method
+ */
+void cUfo::makeBuffers()
+{
+    nIndices = 0;
+    lodOffsets.clear();
+    lod = 0;
+    if(obj2OGL->nMeshIndices == 0) return;
+
+    if(!vertexBuffer.isCreated())
+        vertexBuffer.create();
+    bPackedVertices = obj2OGL->meshPackedData != NULL;
+    int vertexSize = bPackedVertices ? sizeof(sPackedVertex) : sizeof(sVertex);
+    if(bPackedVertices)
+        packing = obj2OGL->meshPacking;
+    else
+        resetPacking();
+
+    vertexBuffer.bind();
+    if(bPackedVertices)
+        vertexBuffer.allocate(obj2OGL->meshPackedData,
+                              obj2OGL->nMeshVertices*vertexSize);
+    else
+        vertexBuffer.allocate(obj2OGL->meshVertexData,
+                              obj2OGL->nMeshVertices*vertexSize);
+    vertexBuffer.release();
+
+    if(!indexBuffer.isCreated())
+        indexBuffer.create();
+    indexBuffer.bind();
+    if(obj2OGL->nMeshVertices <= 65536)
+    {
+        indexType = GL_UNSIGNED_SHORT;
+        QVector<GLushort> indices(obj2OGL->nMeshIndices);
+        for(int i = 0; i < obj2OGL->nMeshIndices; i++)
+            indices[i] = obj2OGL->meshIndexData[i];
+        indexBuffer.allocate(indices.constData(),
+                             indices.size()*sizeof(GLushort));
+    } else
+    {
+        indexType = GL_UNSIGNED_INT;
+        indexBuffer.allocate(obj2OGL->meshIndexData,
+                             obj2OGL->nMeshIndices*sizeof(GLuint));
+    }
+    indexBuffer.release();
+
+    nIndices = obj2OGL->nMeshIndices;
+    lodOffsets = obj2OGL->meshLodOffsets;
+    if(lodOffsets.size() < 2)
+    {
+        lodOffsets.clear();
+        lodOffsets.append(0);
+        lodOffsets.append(nIndices);
+    }
+
+    float dx = obj2OGL->meshMax.x - obj2OGL->meshMin.x;
+    float dy = obj2OGL->meshMax.y - obj2OGL->meshMin.y;
+    float dz = obj2OGL->meshMax.z - obj2OGL->meshMin.z;
+    meshRadius = sqrt(dx*dx + dy*dy + dz*dz) / 2.0;
+
+    hull = obj2OGL->meshHull;
+    hullRadius = 0.0;
+    for(int i = 0; i < hull.size(); i++)
+    {
+        const sPoint3 &p = hull.at(i);
+        hullRadius = qMax(hullRadius, (float) sqrt(p.x*p.x + p.y*p.y +
+                                                   p.z*p.z));
+    }
+}
+
+/*!
+ * \brief Picks LOD from size of ufo on screen.
+ *
+ * \param pixelRadius projected radius of mesh bounds in pixels
+ *
+ * \sa cGLWidget::ufoPixelRadius()
+ */
+void cUfo::selectLod(float pixelRadius)
+{
+    int nLods = lodOffsets.size() - 1;
+    float limit = lodFullDetailPixels;
+    lod = 0;
+    while(lod + 1 < nLods && pixelRadius < limit)
+    {
+        lod++;
+        limit /= 2.0;
+    }
 }
 
 /*!
- * \brief Make display list of cUfo object.
+ * \brief Draws cUfo object.
  *
- * Create display list from parsed data. Attention, call cUfo::makeObject() for
- * the first time before calling this method.
+ * LOD picked by cUfo::selectLod() is drawn by one glDrawElements() call.
  *
- * \return ID of compiled display list.
- * \sa cWormhole::makeDisplayList()
+ * \sa cWormhole::draw()
  * \note pure virtual method
  */
-GLuint cUfo::makeDisplayList(int polygons)
+void cUfo::draw(int polygons)
 {
-    return obj2OGL->createDisplayList();
+    if(nIndices == 0) return;
+
+    vertexBuffer.bind();
+    enableVertexArrays();
+    indexBuffer.bind();
+    size_t first = (size_t) lodOffsets[lod]*indexSize();
+    glDrawElements(GL_TRIANGLES, lodOffsets[lod+1] - lodOffsets[lod],
+                   indexType, (const GLvoid *) first);
+    indexBuffer.release();
+    disableVertexArrays();
+    vertexBuffer.release();
 }
 
 /*!
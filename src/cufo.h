@@ -14,13 +14,18 @@
 
 #include "myinclude.h"
 
+#include <QGLBuffer>
+
 /*!
  * \class cUfo
  * \brief Unidentified Flying Object.
  *
  * UFO's are constructed from obj files supplied in their constructors. Using
- * cObj2OGL object, parsing of the obj file returns display list, that is
- * used right in cGLWidget class object.
+ * cObj2OGL object, the obj file is parsed into an indexed triangle mesh. It
+ * is uploaded to vertex buffers and drawn with a single call from cGLWidget.
+ * Parsing runs in background and its result is shared by every cUfo of the
+ * same obj file, see cUfo::startLoading() and cMeshCache. Simplified LODs of
+ * the mesh share the buffers, cUfo::selectLod() picks the one to draw.
  */
 class cUfo : public cGLObject
 {
@@ -31,11 +36,29 @@ public:
     //GLuint makeObject();
     void makeObject(QProgressBar * progress_bar = NULL,
                     QLabel * progress_label = NULL);
-    GLuint makeDisplayList(int polygons = 0);
+    void makeBuffers();
+    void draw(int polygons = 0);
     void updateObject();
 
+    void makePlaceholder();
+    void startLoading();
+    bool isLoading() const;
+    int loadProgress() const;
+    void waitForLoading();
+
+    void selectLod(float pixelRadius);
+
     sPoint3 pos;
     float radius;
+    float meshRadius; // half diagonal of mesh bounds, set by makeBuffers()
+    QVector<sPoint3> hull; // points of mesh convex hull, see cObj2OGL::meshHull
+    float hullRadius;      // of sphere around origin bounding hull
+
+    QGLBuffer vertexBuffer;
+    QGLBuffer indexBuffer;
+    int nIndices;
+    QVector<int> lodOffsets; // see cObj2OGL::meshLodOffsets
+    int lod;                 // LOD drawn by cUfo::draw()
 };
 
 
@@ -12,20 +12,146 @@
 #include <iostream>
 #include <cmath>
 #include <time.h>
+#include <string.h>
+
+#include <QtConcurrentRun>
+
+// serial numbers of sectors (texture coordinate t) start from 0 again after
+// this many sectors, float texture coordinates would lose precision otherwise
+static const int maxSectorSerial = 16384;
+
+// winding wormhole, see cWormhole::appendControlPoint()
+static const float windingTurn = 0.6;      // change of direction per point
+static const float windingMaxClimb = 0.8;  // y of direction, keeps it off
+                                           // the vertical
+static const float windingClearance = 1.6; // distance between control points
+                                           // of different passes
+static const int windingTries = 16;
+
+// circle frame is built perpendicular to x axis instead of y axis when
+// direction of the wormhole is closer to the vertical than this (squared
+// length of its xz projection), see cWormhole::genCircles()
+static const float verticalFrame = 1e-4;
+
+#if !defined(WH_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || \
+                             (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define WH_SSE
+#include <xmmintrin.h>
+#endif
+
+/*!
+ * \brief Normalizes vector, zero vector becomes (1, 0, 0).
+ */
+static inline void normalizePoint(float &x, float &y, float &z)
+{
+    float d = sqrt(x*x + y*y + z*z);
+    if (d == 0.0)
+    {
+        x = 1;
+        y = 0;
+        z = 0;
+    }
+    else
+    {
+        x = x / d;
+        y = y / d;
+        z = z / d;
+    }
+}
+
+#ifdef WH_SSE
+/*!
+ * \brief Loads 4 consecutive points and splits them to x, y and z vectors.
+ */
+static inline void loadPoints(const sPoint3 * p, __m128 &x, __m128 &y,
+                              __m128 &z)
+{
+    const float * f = &p->x;
+    __m128 a0 = _mm_loadu_ps(f);     // x0 y0 z0 x1
+    __m128 a1 = _mm_loadu_ps(f + 4); // y1 z1 x2 y2
+    __m128 a2 = _mm_loadu_ps(f + 8); // z2 x3 y3 z3
+    __m128 t0 = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(2,1,3,2)); // x2 y2 x3 y3
+    __m128 t1 = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1,0,2,1)); // y0 z0 y1 z1
+    x = _mm_shuffle_ps(a0, t0, _MM_SHUFFLE(2,0,3,0));
+    y = _mm_shuffle_ps(t1, t0, _MM_SHUFFLE(3,1,2,0));
+    z = _mm_shuffle_ps(t1, a2, _MM_SHUFFLE(3,0,3,1));
+}
+
+/*!
+ * \brief Interleaves x, y and z vectors and stores them as 4 points.
+ */
+static inline void storePoints(__m128 x, __m128 y, __m128 z, sPoint3 * p)
+{
+    float * f = &p->x;
+    __m128 xy = _mm_shuffle_ps(x, y, _MM_SHUFFLE(2,0,2,0)); // x0 x2 y0 y2
+    __m128 yz = _mm_shuffle_ps(y, z, _MM_SHUFFLE(3,1,3,1)); // y1 y3 z1 z3
+    __m128 zx = _mm_shuffle_ps(z, x, _MM_SHUFFLE(3,1,2,0)); // z0 z2 x1 x3
+    _mm_storeu_ps(f,     _mm_shuffle_ps(xy, zx, _MM_SHUFFLE(2,0,2,0)));
+    _mm_storeu_ps(f + 4, _mm_shuffle_ps(yz, xy, _MM_SHUFFLE(3,1,2,0)));
+    _mm_storeu_ps(f + 8, _mm_shuffle_ps(zx, yz, _MM_SHUFFLE(3,1,3,1)));
+}
+
+/*!
+ * \brief Vector version of normalizePoint().
+ */
+static inline void normalizePoints(__m128 &x, __m128 &y, __m128 &z,
+                                   __m128 zero, __m128 one)
+{
+    __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                           _mm_mul_ps(z, z));
+    __m128 d = _mm_sqrt_ps(d2);
+    __m128 degenerated = _mm_cmpeq_ps(d, zero);
+    x = _mm_or_ps(_mm_and_ps(degenerated, one),
+                  _mm_andnot_ps(degenerated, _mm_div_ps(x, d)));
+    y = _mm_andnot_ps(degenerated, _mm_div_ps(y, d));
+    z = _mm_andnot_ps(degenerated, _mm_div_ps(z, d));
+}
+#endif
 
 /*!
  * \brief Constructor of cWormhole.
  *
  * Just initializing some variables.
  */
-cWormhole::cWormhole()
+cWormhole::cWormhole() : indexBuffer(QGLBuffer::IndexBuffer)
 {
-    nLists = 1;
     whSectors = 200;
     circleSectors = 25; // circleSectors + 1
     nControlPoints = 20;
     t=4;           // degree of polynomial = t-1
 
+    for(int i=0; i<2; i++)
+    {
+        stores[i].sectorData = NULL;
+        stores[i].sectorCapacity = 0;
+        stores[i].vertexCapacity = 0;
+        stores[i].firstSector = 0;
+        stores[i].firstSerial = 0;
+        stores[i].shiftedSectors = 0;
+        stores[i].firstSpan = 0;
+    }
+    front = &stores[0];
+    back = &stores[1];
+    shifting = false;
+    generation = 0;
+    sectorsPerSpan = 1;
+    bWinding = false;
+
+    weightFirst = NULL;
+    weights = NULL;
+    weightSectors = 0;
+
+    unitCos = NULL;
+    unitSin = NULL;
+    faceNormals = NULL;
+    ringSectors = 0;
+
+    nTriangleIndices = 0;
+    nQuadIndices = 0;
+    indexWhSectors = 0;
+    indexCircleSectors = 0;
+    bPackedVertices = true;
+
     makeObject();
 
 
@@ -34,19 +160,19 @@ cWormhole::cWormhole()
 /*!
  * \brief Destructor of cWormhole.
  *
- * Freeing display list. This is a must, otherwise stability of the entire
+ * Freeing vertex buffers. This is a must, otherwise stability of the entire
  * application will be compromised. Since sliders in cMainWindow force this
  * class to recreate itself.
  */
 cWormhole::~cWormhole()
 {
-    glDeleteLists(object, nLists);
-    for (int i = 0; i < whSectors; i++)
-    {
-        delete[] sectors[i].circle;
-        delete[] sectors[i].normals;
-    }
-    delete[] sectors;
+    waitForShift();
+    vertexBuffer.destroy();
+    indexBuffer.destroy();
+    freeStore(stores[0]);
+    freeStore(stores[1]);
+    freeWeightTable();
+    freeUnitRing();
 }
 
 /*!
@@ -59,21 +185,11 @@ cWormhole::~cWormhole()
  */
 void cWormhole::makeObject(QProgressBar * progress_bar, QLabel * progress_label)
 {
-    sectors = new sSector[whSectors];
-    for (int i = 0; i < whSectors; i++)
-    {
-        sectors[i].circle = new sPoint3[circleSectors];
-        sectors[i].normals = new sPoint3[circleSectors];
-    }
+    allocSectors(whSectors, circleSectors);
 
     initializeWormholeCoordinates();
 
-    bsplineSectorPoints(nControlPoints, t, listControlPoints, sectors,
-                        whSectors);
-    bsplineSectorRadius(nControlPoints, t, listControlRadiusPoints, sectors,
-                        whSectors);
-    genCircles(sectors);
-    genNormals(sectors);
+    generateSectors(*front, 0, whSectors);
 }
 
 /*!
@@ -85,11 +201,17 @@ void cWormhole::makeObject(QProgressBar * progress_bar, QLabel * progress_label)
  */
 void cWormhole::initializeWormholeCoordinates()
 {
-//    listControlPoints.clear();
-//    listControlRadiusPoints.clear();
+    waitForShift();
+
+    QList<sPoint3> &listControlPoints = front->listControlPoints;
+    QList<sPoint3> &listControlRadiusPoints = front->listControlRadiusPoints;
+    listControlPoints.clear();
+    listControlRadiusPoints.clear();
+    front->firstSpan = 0;
 
     srand ( time(NULL) );
     sPoint3 tmpPoint;
+    tmpPoint.y = tmpPoint.z = 0.0; // winding wormhole starts along x axis
     for(int i=-(nControlPoints+1); i < 0 ; i++)
     {
         tmpPoint.x = i;
@@ -102,159 +224,1061 @@ void cWormhole::initializeWormholeCoordinates()
     for(int i=0; i<n; i++)
     {
         listControlPoints.removeFirst();
-        tmpPoint.x = listControlPoints.last().x + 1.0;
-        tmpPoint.y = (rand() % 2000 - 1000) / 1000.0;
-        tmpPoint.z = (rand() % 2000 - 1000) / 1000.0;
+        listControlRadiusPoints.removeFirst();
+        appendControlPoint(*front);
         if(i<4)
         {
-            tmpPoint.y = 0.0;
-            tmpPoint.z = 0.0;
+            listControlPoints.last().x = i;
+            listControlPoints.last().y = 0.0;
+            listControlPoints.last().z = 0.0;
         }
-        listControlPoints.append(tmpPoint);
+    }
+}
 
-        listControlRadiusPoints.removeFirst();
-        tmpPoint.x = listControlRadiusPoints.last().x + 1.0;
-        tmpPoint.y = (rand() % 400 + 200) / 1000.0;
-        tmpPoint.z = 0.0;
-        listControlRadiusPoints.append(tmpPoint);
+/*!
+ * \brief Appends one random control point to the end of wormhole.
+ *
+ * Every control point is one unit further along x axis than the previous one.
+ * Its radius control point is generated along with it.
+ *
+ * Control points of winding wormhole are one unit apart too, but in the
+ * direction of the last two turned randomly by up to windingTurn. Direction
+ * never gets closer to the vertical than windingMaxClimb. Turns bringing the
+ * point within windingClearance of an older control point (another pass of
+ * the wormhole) are tried again, the wormhole goes straight if all of
+ * windingTries fail.
+ */
+void cWormhole::appendControlPoint(sSectorStore &store)
+{
+    sPoint3 tmpPoint;
+    if(!bWinding)
+    {
+        tmpPoint.x = store.listControlPoints.last().x + 1.0;
+        tmpPoint.y = (rand() % 2000 - 1000) / 1000.0;
+        tmpPoint.z = (rand() % 2000 - 1000) / 1000.0;
+    } else
+    {
+        int n = store.listControlPoints.size();
+        const sPoint3 &last = store.listControlPoints.at(n-1);
+        const sPoint3 &prev = store.listControlPoints.at(n-2);
+        float dir[3] = {last.x - prev.x, last.y - prev.y, last.z - prev.z};
+        normalizePoint(dir[0], dir[1], dir[2]);
+
+        float step[3] = {dir[0], dir[1], dir[2]};
+        for(int i = 0; i < windingTries; i++)
+        {
+            float x = dir[0] + windingTurn*(rand() % 2000 - 1000) / 1000.0;
+            float y = dir[1] + windingTurn*(rand() % 2000 - 1000) / 1000.0;
+            float z = dir[2] + windingTurn*(rand() % 2000 - 1000) / 1000.0;
+            normalizePoint(x, y, z);
+            if(fabs(y) > windingMaxClimb) continue;
+
+            // the last two points are neighbours of the new one
+            bool bClear = true;
+            for(int k = 0; k+2 < n && bClear; k++)
+            {
+                const sPoint3 &p = store.listControlPoints.at(k);
+                float dx = last.x + x - p.x;
+                float dy = last.y + y - p.y;
+                float dz = last.z + z - p.z;
+                if(dx*dx + dy*dy + dz*dz < windingClearance*windingClearance)
+                    bClear = false;
+            }
+            if(!bClear) continue;
+
+            step[0] = x;
+            step[1] = y;
+            step[2] = z;
+            break;
+        }
+        tmpPoint.x = last.x + step[0];
+        tmpPoint.y = last.y + step[1];
+        tmpPoint.z = last.z + step[2];
     }
+    store.listControlPoints.append(tmpPoint);
+
+    tmpPoint.x = store.listControlRadiusPoints.last().x + 1.0;
+    tmpPoint.y = (rand() % 400 + 200) / 1000.0;
+    tmpPoint.z = 0.0;
+    store.listControlRadiusPoints.append(tmpPoint);
 }
 
 /*!
  * \brief Updates cWormhole object.
  *
  * Ensures that preferences of cWormhole object can be modified during runtime.
+ * Shift running in background is thrown away.
  *
  * \sa cUfo::updateObject()
  * \note pure virtual method
  */
 void cWormhole::updateObject(int newWhSectors, int newCircleSectors)
 {
-    for (int i = 0; i < whSectors; i++)
+    waitForShift();
+
+    if(newWhSectors != whSectors || newCircleSectors != circleSectors)
+        allocSectors(newWhSectors, newCircleSectors);
+
+    generateSectors(*front, 0, whSectors);
+    front->shiftedSectors = 0;
+    generation++;
+    front->markAllDirty();
+}
+
+/*!
+ * \brief Moves the wormhole forward by nShift control points and waits for it.
+ *
+ * \sa cWormhole::startShift()
+ */
+void cWormhole::shiftObject(int nShift)
+{
+    startShift(nShift);
+    shiftFuture.waitForFinished();
+    finishShift();
+}
+
+/*!
+ * \brief Starts moving the wormhole forward by nShift control points.
+ *
+ * New control points are generated right away (rand() is not called from
+ * the worker), sectors are then generated into the back store by
+ * cWormhole::shiftSectors() in a thread of the global thread pool. Front
+ * store is left untouched, it can be drawn and tested for collisions until
+ * cWormhole::finishShift() swaps the stores.
+ *
+ * Does nothing if another shift is still running.
+ */
+void cWormhole::startShift(int nShift)
+{
+    if(shifting || nShift <= 0) return;
+
+    back->listControlPoints = front->listControlPoints;
+    back->listControlRadiusPoints = front->listControlRadiusPoints;
+    for(int i = 0; i < nShift; i++)
     {
-        delete[] sectors[i].circle;
-        delete[] sectors[i].normals;
+        back->listControlPoints.removeFirst();
+        back->listControlRadiusPoints.removeFirst();
+        appendControlPoint(*back);
     }
-    delete[] sectors;
+    back->firstSpan = front->firstSpan + nShift;
+
+    shifting = true;
+    shiftFuture = QtConcurrent::run(this, &cWormhole::shiftSectors, nShift);
+}
+
+/*!
+ * \brief Makes the shifted wormhole the front one, if it is ready.
+ *
+ * Never blocks, caller has to recreate anything made of the front store
+ * (vertex buffer) when true is returned.
+ *
+ * \return true if the stores were swapped.
+ */
+bool cWormhole::finishShift()
+{
+    if(!shifting || !shiftFuture.isFinished())
+        return false;
+
+    // back store only knows what changed since the front one
+    if(front->dirtyHead > 0 || front->dirtyTail < whSectors)
+        back->markAllDirty();
+
+    qSwap(front, back);
+    shifting = false;
+    return true;
+}
 
-    whSectors = newWhSectors;
+/*!
+ * \brief Waits for the running shift and throws its result away.
+ *
+ * Must be called before the front store or the tables shared with the worker
+ * are modified.
+ */
+void cWormhole::waitForShift()
+{
+    if(!shifting) return;
+
+    shiftFuture.waitForFinished();
+    shifting = false;
+    // back store is no longer the one front store was shifted from
+    front->markAllChanged();
+}
+
+/*!
+ * \brief Generates the shifted wormhole into the back store.
+ *
+ * Control points of the back store are already shifted by nShift. Spline of
+ * the uniform part of the knot vector does not change by this, its sectors
+ * only move towards the entrance by nShift knot spans. So the front store is
+ * copied, its ring rotated and only sectors at both ends (the new ones and
+ * those whose spline support reaches into the clamped knots) are generated
+ * again. Only they are marked to be uploaded to vertex buffer.
+ *
+ * Back store is usually the front store of the previous shift, then only
+ * sectors generated again by that shift are copied instead of whole store.
+ *
+ * Runs in a worker thread, front store is only read.
+ *
+ * \sa cWormhole::startShift()
+ */
+void cWormhole::shiftSectors(int nShift)
+{
+    sSectorStore &store = *back;
+
+    int spans = nControlPoints - t + 2;
+    int reuseFirst = (t - 2) * sectorsPerSpan;
+    int reuseLast = (spans - (t - 2) - nShift) * sectorsPerSpan;
+
+    store.shiftedSectors = front->shiftedSectors + nShift * sectorsPerSpan;
+    store.firstSerial = front->firstSerial + nShift * sectorsPerSpan;
+    bool rebase = store.firstSerial >= maxSectorSerial;
+    if(rebase)
+        store.firstSerial = 0;
+
+    if(reuseLast - 2 <= reuseFirst + 1) // nothing worth reusing
+    {
+        store.firstSector = 0;
+        generateSectors(store, 0, whSectors);
+        store.markAllDirty();
+        return;
+    }
+
+    if(front->changedHead < front->changedTail)
+    {
+        copySectors(store, 0, front->changedHead);
+        copySectors(store, front->changedTail, whSectors);
+    }
+    else
+    {
+        int nVertices = whSectors*circleSectors;
+        memcpy(store.circleData, front->circleData, nVertices*sizeof(sPoint3));
+        memcpy(store.normalData, front->normalData, nVertices*sizeof(sPoint3));
+        memcpy(store.splineData, front->splineData, whSectors*sizeof(sPoint3));
+        memcpy(store.radiusData, front->radiusData, whSectors*sizeof(float));
+    }
+    store.firstSector = (front->firstSector + nShift * sectorsPerSpan) %
+                        whSectors;
+
+    bsplineSectors(store, nControlPoints, t, 0, reuseFirst);
+    bsplineSectors(store, nControlPoints, t, reuseLast, whSectors);
+
+    // circle depends on its spline point and the next one
+    genCircles(store, 0, reuseFirst);
+    genCircles(store, reuseLast - 1, whSectors);
+    // vertex normal depends on neighbouring circles
+    genNormals(store, 0, reuseFirst + 1);
+    genNormals(store, reuseLast - 2, whSectors);
+
+    // only boxes of sectors generated again change
+    store.tree = front->tree;
+    store.tree.refit(store, 0, reuseFirst);
+    store.tree.refit(store, reuseLast, whSectors);
+
+    store.dirtyHead = reuseFirst + 1;
+    store.dirtyTail = reuseLast - 2;
+    store.changedHead = store.dirtyHead;
+    store.changedTail = store.dirtyTail;
+    // texture coordinates of all sectors change
+    if(rebase)
+        store.markAllDirty();
+}
+
+/*!
+ * \brief Copies sectors of the front store to the same ring slots of store.
+ *
+ * Sectors from first up to (but not including) last are copied.
+ */
+void cWormhole::copySectors(sSectorStore &store, int first, int last)
+{
+    for(int i = first; i < last; i++)
+    {
+        int s = front->slot(i);
+        memcpy(store.circleData + s*circleSectors,
+               front->circleData + s*circleSectors,
+               circleSectors*sizeof(sPoint3));
+        memcpy(store.normalData + s*circleSectors,
+               front->normalData + s*circleSectors,
+               circleSectors*sizeof(sPoint3));
+        store.splineData[s] = front->splineData[s];
+        store.radiusData[s] = front->radiusData[s];
+    }
+}
+
+/*!
+ * \brief Generates spline points, circles and normals of sectors.
+ *
+ * Sectors from first up to (but not including) last are generated, their
+ * boxes in cSectorTree of the store are updated.
+ */
+void cWormhole::generateSectors(sSectorStore &store, int first, int last)
+{
+    bsplineSectors(store, nControlPoints, t, first, last);
+    genCircles(store, first, last);
+    genNormals(store, first, last);
+
+    if(first == 0 && last == whSectors)
+    {
+        store.tree.build(store);
+        store.markAllChanged();
+    }
+    else
+        store.tree.refit(store, first, last);
+}
+
+/*!
+ * \brief Allocates sectors ring of both stores.
+ *
+ * Number of sectors is rounded so that each knot span of the spline gets the
+ * same number of sectors. Only then the ring can be rotated by whole spans in
+ * cWormhole::shiftSectors(). Rounded number stays within minWhSectors and
+ * maxWhSectors.
+ */
+void cWormhole::allocSectors(int newWhSectors, int newCircleSectors)
+{
+    int spans = nControlPoints - t + 2;
+    sectorsPerSpan = qRound((newWhSectors - 1) / (double) spans);
+    sectorsPerSpan = qMin(sectorsPerSpan, (maxWhSectors - 1) / spans);
+    sectorsPerSpan = qMax(sectorsPerSpan, (minWhSectors - 2) / spans + 1);
+    whSectors = spans * sectorsPerSpan + 1;
     circleSectors = newCircleSectors;
 
-    sectors = new sSector[whSectors];
-    for (int i = 0; i < whSectors; i++)
+    allocStore(stores[0]);
+    allocStore(stores[1]);
+    generation++;
+
+    // weights depend on number of sectors only, not on circle sectors
+    if(weightSectors != whSectors)
+        buildWeightTable();
+
+    if(ringSectors != circleSectors)
+        buildUnitRing();
+}
+
+/*!
+ * \brief Allocates sectors ring of one store.
+ *
+ * The block of memory is reused as long as it is big enough, it only grows.
+ */
+void cWormhole::allocStore(sSectorStore &store)
+{
+    store.whSectors = whSectors;
+    store.circleSectors = circleSectors;
+    store.firstSector = 0;
+    store.firstSerial = 0;
+    store.shiftedSectors = 0;
+    store.markAllDirty();
+    store.markAllChanged();
+
+    if(whSectors > store.sectorCapacity ||
+       whSectors*circleSectors > store.vertexCapacity)
     {
-        sectors[i].circle = new sPoint3[circleSectors];
-        sectors[i].normals = new sPoint3[circleSectors];
+        freeStore(store);
+        store.sectorCapacity = whSectors;
+        store.vertexCapacity = whSectors*circleSectors;
+
+        // radius stream is packed into sPoint3 sized elements
+        store.sectorData = new sPoint3[2*store.vertexCapacity +
+                                       store.sectorCapacity +
+                                       (store.sectorCapacity + 2)/3];
+        store.circleData = store.sectorData;
+        store.normalData = store.circleData + store.vertexCapacity;
+        store.splineData = store.normalData + store.vertexCapacity;
+        store.radiusData = (float *) (store.splineData + store.sectorCapacity);
     }
+}
 
-    bsplineSectorPoints(nControlPoints, t, listControlPoints, sectors,
-                        whSectors);
-    bsplineSectorRadius(nControlPoints, t, listControlRadiusPoints, sectors,
-                        whSectors);
-    genCircles(sectors);
-    genNormals(sectors);
+/*!
+ * \brief Frees sectors ring of one store.
+ */
+void cWormhole::freeStore(sSectorStore &store)
+{
+    delete [] store.sectorData;
+    store.sectorData = NULL;
+    store.circleData = NULL;
+    store.normalData = NULL;
+    store.splineData = NULL;
+    store.radiusData = NULL;
+    store.sectorCapacity = 0;
+    store.vertexCapacity = 0;
 }
 
 
 /*!
- * \brief Creates openGL display list for wormhole.
+ * \brief Uploads changed sectors of the front store to vertex buffer.
+ *
+ * Vertex buffer mirrors the sectors ring, sector in ring slot s is stored at
+ * vertex s*(circleSectors+1). Every circle is uploaded with circleSectors+1
+ * vertices, the last one is the first vertex again with texture coordinate
+ * s = circleSectors so that the texture does not wrap back across the last
+ * face. Texture coordinate t is the serial number of the sector, so sectors
+ * already in the buffer never need to be uploaded again.
  *
- * Vertex data and OpenGL commands are cached in the display list so calling
- * it in cGLWidget::paintGL() is much faster than creating wormhole object
- * by calling glVertex functions, etc.
+ * After a shift only the regenerated sectors at both ends of the wormhole are
+ * written. Whole buffer is uploaded when the number of sectors changes or the
+ * wormhole is generated from scratch. Index buffer depends only on whSectors
+ * and circleSectors, it is built again only when they change.
  *
- * \return ID of compiled display list.
- * \sa cUfo::makeDisplayList()
+ * If bPackedVertices is set, sPackedVertex is uploaded instead of sVertex.
+ * Packing is chosen again on every whole upload, or when regenerated sectors
+ * get out of its bounds (see cWormhole::choosePacking()).
+ *
+ * Has to be called with current GL context after every regeneration.
+ *
+ * \sa cUfo::makeBuffers()
  * \note pure virtual method
  */
-GLuint cWormhole::makeDisplayList(int polygons)
+void cWormhole::makeBuffers()
 {
-    GLuint list = glGenLists(nLists);
-    glNewList(list, GL_COMPILE);
+    int nVertices = whSectors*(circleSectors + 1);
+    int vertexSize = bPackedVertices ? sizeof(sPackedVertex) : sizeof(sVertex);
+    if(bPackedVertices ? packedVertices.size() != nVertices
+                       : vertices.size() != nVertices)
+    {
+        if(bPackedVertices)
+            packedVertices.resize(nVertices);
+        else
+            vertices.resize(nVertices);
+        front->markAllDirty();
+    }
 
-    qglColor(QColor::fromRgb(145, 44, 238));
-    //glClear(GL_COLOR_BUFFER_BIT);
-    if(polygons)
-        glBegin(GL_QUADS);
+    if(!vertexBuffer.isCreated())
+    {
+        vertexBuffer.create();
+        vertexBuffer.setUsagePattern(QGLBuffer::DynamicDraw);
+    }
+    vertexBuffer.bind();
+    if(vertexBuffer.size() != nVertices*vertexSize)
+    {
+        vertexBuffer.allocate(nVertices*vertexSize);
+        front->markAllDirty();
+    }
+
+    if(!bPackedVertices)
+        resetPacking();
+    else if(front->dirtyHead >= front->dirtyTail)
+        choosePacking();
+    else if(!packingCovers(0, front->dirtyHead) ||
+            !packingCovers(front->dirtyTail, whSectors))
+    {
+        choosePacking();
+        front->markAllDirty();
+    }
+
+    if(front->dirtyHead >= front->dirtyTail)
+    {
+        uploadSectors(0, whSectors);
+    }
     else
-        glBegin(GL_TRIANGLES);
-        for (int j=0; j<whSectors-1; j++)
+    {
+        uploadSectors(0, front->dirtyHead);
+        uploadSectors(front->dirtyTail, whSectors);
+    }
+    vertexBuffer.release();
+
+    front->dirtyHead = 0;
+    front->dirtyTail = whSectors;
+
+    if(indexWhSectors != whSectors || indexCircleSectors != circleSectors)
+        buildIndices();
+}
+
+/*!
+ * \brief Whether packing can hold sectors <first, last) of the front store.
+ *
+ * Circle of a sector lies within its radius around its spline point.
+ */
+bool cWormhole::packingCovers(int first, int last)
+{
+    float reach = 32767.0*packing.scale;
+    for (int j=first; j<last; j++)
+    {
+        const sPoint3 &p = front->splinePoint(j);
+        float r = front->radius(j);
+        if(fabs(p.x - packing.offset[0]) + r > reach ||
+           fabs(p.y - packing.offset[1]) + r > reach ||
+           fabs(p.z - packing.offset[2]) + r > reach)
+            return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief Chooses packing of vertices for the front store.
+ *
+ * Packing is centered on the bounds of all sectors and reaches twice as far
+ * as they do, so sectors regenerated by the next few shifts still fit in.
+ * Texture coordinates are small integers, they are stored as they are.
+ */
+void cWormhole::choosePacking()
+{
+    sPoint3 lo, hi;
+    for (int j=0; j<whSectors; j++)
+    {
+        const sPoint3 &p = front->splinePoint(j);
+        float r = front->radius(j);
+        if(j == 0 || p.x - r < lo.x) lo.x = p.x - r;
+        if(j == 0 || p.y - r < lo.y) lo.y = p.y - r;
+        if(j == 0 || p.z - r < lo.z) lo.z = p.z - r;
+        if(j == 0 || p.x + r > hi.x) hi.x = p.x + r;
+        if(j == 0 || p.y + r > hi.y) hi.y = p.y + r;
+        if(j == 0 || p.z + r > hi.z) hi.z = p.z + r;
+    }
+
+    float half = qMax(qMax(hi.x - lo.x, hi.y - lo.y), hi.z - lo.z);
+    packing.offset[0] = (lo.x + hi.x) / 2.0;
+    packing.offset[1] = (lo.y + hi.y) / 2.0;
+    packing.offset[2] = (lo.z + hi.z) / 2.0;
+    packing.scale = half > 0.0 ? half / 32767.0 : 1.0;
+    packing.texOffset[0] = packing.texOffset[1] = 0.0;
+    packing.texScale = 1.0;
+}
+
+/*!
+ * \brief Writes sectors <first, last) of the front store to vertex buffer.
+ *
+ * Sectors are continuous in the ring, except when they wrap around its end.
+ * Then they are written in two parts. Vertex buffer has to be bound.
+ */
+void cWormhole::uploadSectors(int first, int last)
+{
+    int ringVertices = circleSectors + 1;
+
+    while(first < last)
+    {
+        int slot = front->slot(first);
+        int count = qMin(last - first, whSectors - slot);
+
+        int index = slot*ringVertices;
+        for (int j=first; j<first+count; j++)
         {
-            for(int i=0; i<circleSectors-1; i++)
+            sPoint3 * c = front->circle(j);
+            sPoint3 * n = front->normals(j);
+            float serial = front->firstSerial + j;
+            for (int i=0; i<ringVertices; i++, index++)
             {
-                /*qglColor(trolltechGreen.dark((int)(250 +\
-                                              sin(1.5*sectors[j].circle[i].x) *\
-                                              100)));*/
-                if(polygons)
-                {
-                    quad(sectors[j].normals[i], sectors[j].circle[i],
-                         sectors[j+1].normals[i], sectors[j+1].circle[i],
-                         sectors[j+1].normals[i+1], sectors[j+1].circle[i+1],
-                         sectors[j].normals[i+1], sectors[j].circle[i+1]);
-                } else
-                {
-                    triangle(sectors[j].normals[i], sectors[j].circle[i],
-                         sectors[j+1].normals[i], sectors[j+1].circle[i],
-                         sectors[j+1].normals[i+1], sectors[j+1].circle[i+1]);
-                    triangle(sectors[j+1].normals[i+1], sectors[j+1].circle[i+1],
-                         sectors[j].normals[i+1], sectors[j].circle[i+1],
-                         sectors[j].normals[i], sectors[j].circle[i]);
-                }
-            }
-            int last = circleSectors-1;
-            if(polygons)
-            {
-                quad(sectors[j].normals[last], sectors[j].circle[last],
-                     sectors[j+1].normals[last], sectors[j+1].circle[last],
-                     sectors[j+1].normals[0], sectors[j+1].circle[0],
-                     sectors[j].normals[0], sectors[j].circle[0]);
-            } else
-            {
-                triangle(sectors[j].normals[last],sectors[j].circle[last],
-                     sectors[j+1].normals[last], sectors[j+1].circle[last],
-                     sectors[j+1].normals[0], sectors[j+1].circle[0]);
-                triangle(sectors[j+1].normals[0], sectors[j+1].circle[0],
-                     sectors[j].normals[0], sectors[j].circle[0],
-                     sectors[j].normals[last], sectors[j].circle[last]);
+                int k = (i < circleSectors) ? i : 0;
+                sVertex v;
+                v.x = c[k].x;
+                v.y = c[k].y;
+                v.z = c[k].z;
+                v.nx = n[k].x;
+                v.ny = n[k].y;
+                v.nz = n[k].z;
+                v.s = i;
+                v.t = serial;
+                if(bPackedVertices)
+                    packVertex(v, packing, packedVertices[index]);
+                else
+                    vertices[index] = v;
             }
         }
-    glEnd();
 
-    glEndList();
-    
-    return list;
+        if(bPackedVertices)
+            vertexBuffer.write(slot*ringVertices*sizeof(sPackedVertex),
+                               packedVertices.constData() + slot*ringVertices,
+                               count*ringVertices*sizeof(sPackedVertex));
+        else
+            vertexBuffer.write(slot*ringVertices*sizeof(sVertex),
+                               vertices.constData() + slot*ringVertices,
+                               count*ringVertices*sizeof(sVertex));
+        first += count;
+    }
+}
+
+/*!
+ * \brief Builds index buffer of wormhole.
+ *
+ * There is one row of faces for every ring slot s, between slots s and s+1.
+ * The last row joins the end of the ring with its beginning, so rows can be
+ * drawn from any slot (see cWormhole::draw()). Triangle indices (two
+ * triangles per face) of all rows are followed by quad indices (one quad per
+ * face) in the same buffer. Indices are uploaded as GLushort when there are
+ * few enough vertices.
+ */
+void cWormhole::buildIndices()
+{
+    int ringVertices = circleSectors + 1;
+    int faces = whSectors*circleSectors;
+    nTriangleIndices = 6*faces;
+    nQuadIndices = 4*faces;
+
+    QVector<GLuint> indices(nTriangleIndices + nQuadIndices);
+    GLuint * tri = indices.data();
+    GLuint * quad = tri + nTriangleIndices;
+    for (int j=0; j<whSectors; j++)
+    {
+        int next = (j+1 < whSectors) ? j+1 : 0;
+        for (int i=0; i<circleSectors; i++)
+        {
+            GLuint a = j*ringVertices + i;    // ring slot j
+            GLuint b = next*ringVertices + i; // ring slot j+1
+
+            *tri++ = a;
+            *tri++ = b;
+            *tri++ = b + 1;
+            *tri++ = b + 1;
+            *tri++ = a + 1;
+            *tri++ = a;
+
+            *quad++ = a;
+            *quad++ = b;
+            *quad++ = b + 1;
+            *quad++ = a + 1;
+        }
+    }
+
+    if(!indexBuffer.isCreated())
+    {
+        indexBuffer.create();
+        indexBuffer.setUsagePattern(QGLBuffer::StaticDraw);
+    }
+    indexBuffer.bind();
+    if(whSectors*ringVertices <= 65536)
+    {
+        indexType = GL_UNSIGNED_SHORT;
+        QVector<GLushort> shortIndices(indices.size());
+        for (int i=0; i<indices.size(); i++)
+            shortIndices[i] = indices.at(i);
+        indexBuffer.allocate(shortIndices.constData(),
+                             shortIndices.size()*sizeof(GLushort));
+    }
+    else
+    {
+        indexType = GL_UNSIGNED_INT;
+        indexBuffer.allocate(indices.constData(),
+                             indices.size()*sizeof(GLuint));
+    }
+    indexBuffer.release();
+
+    indexWhSectors = whSectors;
+    indexCircleSectors = circleSectors;
+}
+
+/*!
+ * \brief Draws wormhole from vertex and index buffers.
+ *
+ * Rows of faces are drawn from the entrance slot to the end of the ring and
+ * from the beginning of the ring up to the exit. Row joining the exit with
+ * the entrance is skipped.
+ *
+ * Quads cover the whole texture twice in both directions, triangles once.
+ * Texture matrix is scaled for quads to keep it that way.
+ *
+ * \sa cUfo::draw()
+ * \note pure virtual method
+ */
+void cWormhole::draw(int polygons)
+{
+    qglColor(QColor::fromRgb(145, 44, 238));
+
+    if(polygons)
+    {
+        glMatrixMode(GL_TEXTURE);
+        glPushMatrix();
+        glScalef(2.0, 2.0, 1.0);
+        glMatrixMode(GL_MODELVIEW);
+    }
+
+    vertexBuffer.bind();
+    enableVertexArrays();
+
+    GLenum mode = polygons ? GL_QUADS : GL_TRIANGLES;
+    int rowIndices = (polygons ? 4 : 6)*circleSectors;
+    int base = polygons ? nTriangleIndices : 0;
+
+    int entrance = front->firstSector;
+    int headRows = qMin(whSectors - 1, whSectors - entrance);
+    int tailRows = (whSectors - 1) - headRows;
+    size_t indexBytes = indexSize();
+
+    indexBuffer.bind();
+    glDrawElements(mode, headRows*rowIndices, indexType,
+                   (const GLvoid *) ((base + entrance*rowIndices) *
+                                     indexBytes));
+    if(tailRows > 0)
+        glDrawElements(mode, tailRows*rowIndices, indexType,
+                       (const GLvoid *) (base*indexBytes));
+    indexBuffer.release();
+
+    disableVertexArrays();
+    vertexBuffer.release();
+
+    if(polygons)
+    {
+        glMatrixMode(GL_TEXTURE);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+    }
+}
+
+/*!
+ * \brief Whether any of n points inside sector j reaches its wall.
+ *
+ * Points are given as three streams x, y and z. Only points inside the sector
+ * are tested, those between planes of spline points j-1 and j (see
+ * cWormhole::planeDistance()). Wall of the sector is a cone around the line
+ * between the spline points, its radius goes linearly from radius(j-1) to
+ * radius(j) along the line. Points are tested four at a time.
+ */
+bool cWormhole::touchesWall(int j, const float * x, const float * y,
+                            const float * z, int n)
+{
+    sPoint3 s0 = splinePoint(j-1);
+    sPoint3 s1 = splinePoint(j);
+    float r0 = radius(j-1);
+    float dr = radius(j) - r0;
+
+    float u[3] = {s1.x - s0.x, s1.y - s0.y, s1.z - s0.z};
+    float len = sqrt(u[0]*u[0] + u[1]*u[1] + u[2]*u[2]);
+    if (len == 0.0) return false;
+    for (int k=0; k<3; k++)
+        u[k] /= len;
+    float n0[3], n1[3];
+    tangent(j-1, n0);
+    tangent(j, n1);
+    // plane of spline point j relative to s0
+    float d1 = (s1.x - s0.x)*n1[0] + (s1.y - s0.y)*n1[1] + (s1.z - s0.z)*n1[2];
+
+    int i = 0;
+#ifdef WH_SSE
+    __m128 ox = _mm_set1_ps(s0.x), oy = _mm_set1_ps(s0.y);
+    __m128 oz = _mm_set1_ps(s0.z);
+    __m128 ux = _mm_set1_ps(u[0]), uy = _mm_set1_ps(u[1]);
+    __m128 uz = _mm_set1_ps(u[2]);
+    __m128 rBase = _mm_set1_ps(r0), rSlope = _mm_set1_ps(dr/len);
+    __m128 zero = _mm_setzero_ps(), maxAlong = _mm_set1_ps(len);
+    __m128 n0x = _mm_set1_ps(n0[0]), n0y = _mm_set1_ps(n0[1]);
+    __m128 n0z = _mm_set1_ps(n0[2]);
+    __m128 n1x = _mm_set1_ps(n1[0]), n1y = _mm_set1_ps(n1[1]);
+    __m128 n1z = _mm_set1_ps(n1[2]), plane1 = _mm_set1_ps(d1);
+    for (; i+4 <= n; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), ox);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), oy);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), oz);
+        __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, ux),
+                                             _mm_mul_ps(dy, uy)),
+                                  _mm_mul_ps(dz, uz));
+        __m128 d2 = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                                                     _mm_mul_ps(dy, dy)),
+                                          _mm_mul_ps(dz, dz)),
+                               _mm_mul_ps(along, along));
+        __m128 a0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, n0x),
+                                          _mm_mul_ps(dy, n0y)),
+                               _mm_mul_ps(dz, n0z));
+        __m128 a1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, n1x),
+                                          _mm_mul_ps(dy, n1y)),
+                               _mm_mul_ps(dz, n1z));
+        __m128 inside = _mm_and_ps(_mm_cmpgt_ps(a0, zero),
+                                   _mm_cmple_ps(a1, plane1));
+        along = _mm_min_ps(_mm_max_ps(along, zero), maxAlong);
+        __m128 r = _mm_add_ps(rBase, _mm_mul_ps(along, rSlope));
+        __m128 hit = _mm_and_ps(_mm_cmpge_ps(d2, _mm_mul_ps(r, r)), inside);
+        if (_mm_movemask_ps(hit))
+            return true;
+    }
+#endif
+    for (; i < n; i++)
+    {
+        float dx = x[i] - s0.x;
+        float dy = y[i] - s0.y;
+        float dz = z[i] - s0.z;
+        if (!(dx*n0[0] + dy*n0[1] + dz*n0[2] > 0.0 &&
+              dx*n1[0] + dy*n1[1] + dz*n1[2] <= d1)) continue;
+        float along = dx*u[0] + dy*u[1] + dz*u[2];
+        float d2 = dx*dx + dy*dy + dz*dz - along*along;
+        float r = r0 + qBound(0.0f, along, len)*dr/len;
+        if (d2 >= r*r)
+            return true;
+    }
+    return false;
+}
+
+/*!
+ * \brief Direction of the wormhole at spline point i, into n.
+ *
+ * It is halfway between directions of sectors i and i+1, the end points take
+ * direction of their only sector.
+ */
+void cWormhole::tangent(int i, float * n)
+{
+    const sPoint3 &s = splinePoint(i);
+    n[0] = n[1] = n[2] = 0.0;
+    if (i > 0)
+    {
+        const sPoint3 &a = splinePoint(i-1);
+        float x = s.x - a.x, y = s.y - a.y, z = s.z - a.z;
+        normalizePoint(x, y, z);
+        n[0] += x;
+        n[1] += y;
+        n[2] += z;
+    }
+    if (i < whSectors-1)
+    {
+        const sPoint3 &b = splinePoint(i+1);
+        float x = b.x - s.x, y = b.y - s.y, z = b.z - s.z;
+        normalizePoint(x, y, z);
+        n[0] += x;
+        n[1] += y;
+        n[2] += z;
+    }
+    normalizePoint(n[0], n[1], n[2]);
+}
+
+/*!
+ * \brief Signed distance of point p from plane of spline point i.
+ *
+ * Plane goes through the spline point perpendicular to the wormhole there
+ * (see cWormhole::tangent()), so it parts sectors i and i+1 even in bends of
+ * winding wormhole. Wormhole going along x axis is parted about as by x.
+ *
+ * \return positive beyond the plane (towards sector i+1).
+ */
+float cWormhole::planeDistance(int i, const sPoint3 &p)
+{
+    const sPoint3 &s = splinePoint(i);
+    float n[3];
+    tangent(i, n);
+
+    return (p.x - s.x)*n[0] + (p.y - s.y)*n[1] + (p.z - s.z)*n[2];
+}
+
+/*!
+ * \brief Position of point p between planes of spline points j-1 and j.
+ *
+ * \return 0 on plane of spline point j-1, 1 on plane of spline point j.
+ * Point is inside sector j when the result is in 0 ... 1.
+ * \sa cWormhole::planeDistance()
+ */
+float cWormhole::sectorParam(int j, const sPoint3 &p)
+{
+    float d0 = planeDistance(j-1, p);
+    float d1 = planeDistance(j, p);
+    // far from the wormhole, where the planes cross
+    if (d0 - d1 <= 0.0) return d0 < 0.0 ? -1.0 : 1.0;
+
+    return d0 / (d0 - d1);
+}
+
+/*!
+ * \brief How far spline point i of the front store is along the wormhole.
+ *
+ * Distance is counted in control points since they were initialized, the
+ * spline is evaluated as if control point k was at k. For wormhole going along
+ * x axis it is x of the spline point.
+ */
+float cWormhole::splineDistance(int i)
+{
+    const double *w = weights + i*t;
+    int k0 = weightFirst[i];
+
+    double d = front->firstSpan;
+    for (int k=0; k<t; k++)
+        d += (k0 + k) * w[k];
+    return d;
+}
+
+/*!
+ * \brief Sector of the front store whose line is the closest to point p.
+ *
+ * \return sector, 1 ... whSectors-2.
+ * \sa cSectorTree::nearest()
+ */
+int cWormhole::nearestSector(const sPoint3 &p)
+{
+    int j = front->tree.nearest(*front, p);
+    return qBound(1, j, whSectors - 2);
+}
+
+/*!
+ * \brief Appends sectors of the front store that may reach into box min-max
+ * to sectors.
+ *
+ * \sa cSectorTree::overlaps()
+ */
+void cWormhole::sectorsNear(const sPoint3 &min, const sPoint3 &max,
+                            QVector<int> &sectors)
+{
+    front->tree.overlaps(*front, min, max, sectors);
+}
+
+/*!
+ * \brief Places unit ring into the frame of one sector.
+ *
+ * Vertex j is a + cosT[j]*ru + sinT[j]*rv, where ru and rv are the frame
+ * vectors already scaled by radius of the sector.
+ */
+static void transformRing(const float * cosT, const float * sinT, int n,
+                          const float a[3], const float ru[3],
+                          const float rv[3], sPoint3 * out)
+{
+    int j = 0;
+#ifdef WH_SSE
+    __m128 ax = _mm_set1_ps(a[0]), ay = _mm_set1_ps(a[1]);
+    __m128 az = _mm_set1_ps(a[2]);
+    __m128 ux = _mm_set1_ps(ru[0]), uy = _mm_set1_ps(ru[1]);
+    __m128 uz = _mm_set1_ps(ru[2]);
+    __m128 vx = _mm_set1_ps(rv[0]), vy = _mm_set1_ps(rv[1]);
+    __m128 vz = _mm_set1_ps(rv[2]);
+    for (; j+4 <= n; j += 4)
+    {
+        __m128 c = _mm_loadu_ps(cosT + j);
+        __m128 s = _mm_loadu_ps(sinT + j);
+        __m128 x = _mm_add_ps(ax, _mm_add_ps(_mm_mul_ps(c, ux),
+                                             _mm_mul_ps(s, vx)));
+        __m128 y = _mm_add_ps(ay, _mm_add_ps(_mm_mul_ps(c, uy),
+                                             _mm_mul_ps(s, vy)));
+        __m128 z = _mm_add_ps(az, _mm_add_ps(_mm_mul_ps(c, uz),
+                                             _mm_mul_ps(s, vz)));
+        storePoints(x, y, z, out + j);
+    }
+#endif
+    for (; j < n; j++)
+    {
+        out[j].x = a[0] + (cosT[j]*ru[0] + sinT[j]*rv[0]);
+        out[j].y = a[1] + (cosT[j]*ru[1] + sinT[j]*rv[1]);
+        out[j].z = a[2] + (cosT[j]*ru[2] + sinT[j]*rv[2]);
+    }
+}
+
+/*!
+ * \brief Computes unit normals of one row of faces.
+ *
+ * Face i lies between circles c0 and c1 and is defined by points c0[i],
+ * c1[i] and c1[i+1]. Normal components are written to separate streams
+ * nx, ny and nz. Degenerated faces get normal (1, 0, 0).
+ */
+static void faceNormalRow(const sPoint3 * c0, const sPoint3 * c1, int n,
+                          float * nx, float * ny, float * nz)
+{
+    int i = 0;
+#ifdef WH_SSE
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    // c1 + i + 4 is read as well, the last face has to wrap around
+    for (; i+5 <= n; i += 4)
+    {
+        __m128 x0, y0, z0, x1, y1, z1, x2, y2, z2;
+        loadPoints(c0 + i, x0, y0, z0);
+        loadPoints(c1 + i, x1, y1, z1);
+        loadPoints(c1 + i + 1, x2, y2, z2);
+        __m128 dx1 = _mm_sub_ps(x1, x0), dx2 = _mm_sub_ps(x2, x0);
+        __m128 dy1 = _mm_sub_ps(y1, y0), dy2 = _mm_sub_ps(y2, y0);
+        __m128 dz1 = _mm_sub_ps(z1, z0), dz2 = _mm_sub_ps(z2, z0);
+        __m128 x = _mm_sub_ps(_mm_mul_ps(dy1, dz2), _mm_mul_ps(dz1, dy2));
+        __m128 y = _mm_sub_ps(_mm_mul_ps(dz1, dx2), _mm_mul_ps(dx1, dz2));
+        __m128 z = _mm_sub_ps(_mm_mul_ps(dx1, dy2), _mm_mul_ps(dy1, dx2));
+        normalizePoints(x, y, z, zero, one);
+        _mm_storeu_ps(nx + i, x);
+        _mm_storeu_ps(ny + i, y);
+        _mm_storeu_ps(nz + i, z);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        int next = (i+1 < n) ? i+1 : 0;
+        float dx1 = c1[i].x - c0[i].x;
+        float dy1 = c1[i].y - c0[i].y;
+        float dz1 = c1[i].z - c0[i].z;
+        float dx2 = c1[next].x - c0[i].x;
+        float dy2 = c1[next].y - c0[i].y;
+        float dz2 = c1[next].z - c0[i].z;
+        float x = dy1*dz2 - dz1*dy2;
+        float y = dz1*dx2 - dx1*dz2;
+        float z = dx1*dy2 - dy1*dx2;
+        normalizePoint(x, y, z);
+        nx[i] = x;
+        ny[i] = y;
+        nz[i] = z;
+    }
 }
 
-/*void cWormhole::genPoints()
+/*!
+ * \brief Computes unit vertex normals of one circle.
+ *
+ * Vertex i of a circle is shared by faces i-1 and i of the face row before
+ * the circle (prev) and of the one after it (next). Both rows are summed to
+ * sum first, shifted by one so that sum[i] and sum[i+1] are faces i-1 and i.
+ * Every vertex then reads two neighbouring sums, nothing is scattered.
+ *
+ * Rows are stored as three streams (x, y, z), stride floats apart.
+ */
+static void vertexNormalRow(const float * prev, const float * next,
+                            float * sum, int n, int stride, sPoint3 * out)
 {
-  //int n,t,i;
-  //n=nControlPoints;          // number of control points = n+1
-  int t=4;           // degree of polynomial = t-1
+    for (int c=0; c<3; c++)
+    {
+        const float * p = prev + c*stride;
+        const float * q = next + c*stride;
+        float * s = sum + c*stride;
+        int i = 0;
+#ifdef WH_SSE
+        for (; i+4 <= n; i += 4)
+            _mm_storeu_ps(s + i + 1, _mm_add_ps(_mm_loadu_ps(p + i),
+                                                _mm_loadu_ps(q + i)));
+#endif
+        for (; i < n; i++)
+            s[i+1] = p[i] + q[i];
+        s[0] = s[n];
+    }
 
-  bspline(nControlPoints, t, listControlPoints, sector, whSectors);
-}*/
+    const float * sx = sum;
+    const float * sy = sum + stride;
+    const float * sz = sum + 2*stride;
+    int i = 0;
+#ifdef WH_SSE
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    for (; i+4 <= n; i += 4)
+    {
+        __m128 x = _mm_add_ps(_mm_loadu_ps(sx + i), _mm_loadu_ps(sx + i + 1));
+        __m128 y = _mm_add_ps(_mm_loadu_ps(sy + i), _mm_loadu_ps(sy + i + 1));
+        __m128 z = _mm_add_ps(_mm_loadu_ps(sz + i), _mm_loadu_ps(sz + i + 1));
+        normalizePoints(x, y, z, zero, one);
+        storePoints(x, y, z, out + i);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        float x = sx[i] + sx[i+1];
+        float y = sy[i] + sy[i+1];
+        float z = sz[i] + sz[i+1];
+        normalizePoint(x, y, z);
+        out[i].x = x;
+        out[i].y = y;
+        out[i].z = z;
+    }
+}
 
 /*!
  * \brief Generate circle sectors for every spline point in wormhole.
  *
  * For each spline point there has to be a circle. This is needed for rendering
  * the wormhole around these spline points. Each circle has its own radius.
+ *
+ * Cosines and sines of the circle are taken from the unit ring (see
+ * cWormhole::buildUnitRing()), only the frame differs between sectors.
  */
-void cWormhole::genCircles(sSector *sectors)
+void cWormhole::genCircles(sSectorStore &store, int first, int last)
 {
-    for(int i=0; i < whSectors; i++)
+    first = qMax(first, 0);
+    last = qMin(last, whSectors);
+    for(int i=first; i < last; i++)
     {
-        const double Pi = 3.14159265358979323846;
-        float ax = sectors[i].splinePoint.x;//1000.0;
-        float ay = sectors[i].splinePoint.y;//1000.0;
-        float az = sectors[i].splinePoint.z;//1000.0;
-        float bx = sectors[i+1].splinePoint.x;//1000.0;
-        float by = sectors[i+1].splinePoint.y;//1000.0;
-        float bz = sectors[i+1].splinePoint.z;//1000.0;
+        float a[3];
+        a[0] = store.splinePoint(i).x;
+        a[1] = store.splinePoint(i).y;
+        a[2] = store.splinePoint(i).z;
+
+        // last circle is directed the same way as the one before it
+        sPoint3 pointA = (i+1 < whSectors) ? store.splinePoint(i)
+                                           : store.splinePoint(i-1);
+        sPoint3 pointB = (i+1 < whSectors) ? store.splinePoint(i+1)
+                                           : store.splinePoint(i);
 
-        float w0 = bx-ax;
-        float w1 = by-ay;
-        float w2 = bz-az;
+        float w0 = pointB.x-pointA.x;
+        float w1 = pointB.y-pointA.y;
+        float w2 = pointB.z-pointA.z;
         float factor;
         float u0, u1, u2;
         float v0, v1, v2;
@@ -264,306 +1288,196 @@ void cWormhole::genCircles(sSector *sectors)
         w1 = w1/w3d; // normalizing
         w2 = w2/w3d; // normalizing
 
-//        if (fabs(w0) >= fabs(w1)) {
+        // winding wormhole may go (almost) vertically, frame around y axis
+        // would fall apart
+        if (w0*w0+w2*w2 >= verticalFrame) {
             factor = 1/sqrt(w0*w0+w2*w2);
             u0 = -w2*factor;
             u1 = 0;
             u2 = w0*factor;
-/*        } else {
+        } else {
             factor = 1/sqrt(w1*w1+w2*w2);
             u0 = 0;
             u1 = w2*factor;
             u2 = -w1*factor;
-        }*/
+        }
 
-        /*float u3d = sqrt(u0*u0+u1*u1+u2*u2);
-        u0 = u0/u3d; // normalizing
-        u1 = u1/u3d; // normalizing
-        u2 = u2/u3d; // normalizing*/
         //a x b = (a2b3 - a3b2)i + (a3b1 - a1b3)j + (a1b2 - a2b1)k
         //V = Cross(W,U);
         v0 = w1*u2 - w2*u1;
         v1 = w2*u0 - w0*u2;
         v2 = w0*u1 - w1*u0;
 
-        /*float v3d = sqrt(v0*v0+v1*v1+v2*v2);
-        v0 = v0/v3d; // normalizing
-        v1 = v1/v3d; // normalizing
-        v2 = v2/v3d; // normalizing*/
         //X(t) = C + (r*cos(t))*U + (r*sin(t))*V
-        int j;
-        float circleRadius = sectors[i].radius;
-        for (j = 0; j < circleSectors; ++j) {
-            double angle1 = (j * 2 * Pi) / (circleSectors);
-            sectors[i].circle[j].x = ax + (circleRadius*cos(angle1))*u0 \
-                                        + (circleRadius*sin(angle1))*v0;
-            sectors[i].circle[j].y = ay + (circleRadius*cos(angle1))*u1 \
-                                        + (circleRadius*sin(angle1))*v1;
-            sectors[i].circle[j].z = az + (circleRadius*cos(angle1))*u2 \
-                                        + (circleRadius*sin(angle1))*v2;
-        }
-        /*sectors[i].circle[circleSectors-1].x = ax + (circleRadius*cos(0))*u0 \
-                                    + (circleRadius*sin(0))*v0;
-        sectors[i].circle[circleSectors-1].y = ay + (circleRadius*cos(0))*u1 \
-                                    + (circleRadius*sin(0))*v1;
-        sectors[i].circle[circleSectors-1].z = az + (circleRadius*cos(0))*u2 \
-                                    + (circleRadius*sin(0))*v2;*/
-        /*sectors[i].w.x = ax+w0/2.;
-        sectors[i].w.y = ay+w1/2.;
-        sectors[i].w.z = az+w2/2.;
-        sectors[i].u.x = ax+u0/2.;
-        sectors[i].u.y = ay+u1/2.;
-        sectors[i].u.z = az+u2/2.;
-        sectors[i].v.x = ax+v0/2.;
-        sectors[i].v.y = ay+v1/2.;
-        sectors[i].v.z = az+v2/2.;
-        sectors[i].a.x = ax;
-        sectors[i].a.y = ay;
-        sectors[i].a.z = az;*/
+        float circleRadius = store.radius(i);
+        float ru[3] = { circleRadius*u0, circleRadius*u1, circleRadius*u2 };
+        float rv[3] = { circleRadius*v0, circleRadius*v1, circleRadius*v2 };
+        transformRing(unitCos, unitSin, circleSectors, a, ru, rv,
+                      store.circle(i));
     }
 }
 
 /*!
  * \brief Generate vertex normals for wormhole.
  *
- * Method cWormhole::computeFaceNormal() gets called on every face of the
- * wormhole. Face normal is than added to every point in face. By the end of
- * this process vertex normals are calculated. There is only one thing left
- * to do. Normalizing them, which is done by calling
- * cWormhole::normalizeVertexNormals() method.
+ * Normals of faces between two neighbouring circles are computed row by row.
+ * Vertex normal is then the normalized sum of the four faces sharing the
+ * vertex, two from the row before its circle and two from the row after it.
+ * Only the last two face rows are kept in cWormhole::faceNormals.
  */
-void cWormhole::genNormals(sSector *sectors)
+void cWormhole::genNormals(sSectorStore &store, int first, int last)
 {
-    for (int j=0; j<whSectors; j++)
-    {
-        for(int i=0; i<circleSectors; i++)
-        {
-            sectors[j].normals[i].x = 0.0;
-            sectors[j].normals[i].y = 0.0;
-            sectors[j].normals[i].z = 0.0;
-        }
-    }
-    
-    sPoint3 tempPoint;
-    for (int j=0; j<whSectors-1; j++)
-    {
-        for(int i=0; i < circleSectors-1; i++)
-        {
-            tempPoint = computeFaceNormal(sectors[j].circle[i],\
-                                          sectors[j+1].circle[i],\
-                                          sectors[j+1].circle[i+1]);
-            sectors[j].normals[i].x += tempPoint.x;
-            sectors[j].normals[i].y += tempPoint.y;
-            sectors[j].normals[i].z += tempPoint.z;
-            sectors[j+1].normals[i].x += tempPoint.x;
-            sectors[j+1].normals[i].y += tempPoint.y;
-            sectors[j+1].normals[i].z += tempPoint.z;
-            sectors[j+1].normals[i+1].x += tempPoint.x;
-            sectors[j+1].normals[i+1].y += tempPoint.y;
-            sectors[j+1].normals[i+1].z += tempPoint.z;
-            sectors[j].normals[i+1].x += tempPoint.x;
-            sectors[j].normals[i+1].y += tempPoint.y;
-            sectors[j].normals[i+1].z += tempPoint.z;
-        }
-        tempPoint = computeFaceNormal(sectors[j].circle[circleSectors-1],\
-                                      sectors[j+1].circle[circleSectors-1],\
-                                      sectors[j+1].circle[0]);
-        sectors[j].normals[circleSectors-1].x += tempPoint.x;
-        sectors[j].normals[circleSectors-1].y += tempPoint.y;
-        sectors[j].normals[circleSectors-1].z += tempPoint.z;
-        sectors[j+1].normals[circleSectors-1].x += tempPoint.x;
-        sectors[j+1].normals[circleSectors-1].y += tempPoint.y;
-        sectors[j+1].normals[circleSectors-1].z += tempPoint.z;
-        sectors[j+1].normals[0].x += tempPoint.x;
-        sectors[j+1].normals[0].y += tempPoint.y;
-        sectors[j+1].normals[0].z += tempPoint.z;
-        sectors[j].normals[0].x += tempPoint.x;
-        sectors[j].normals[0].y += tempPoint.y;
-        sectors[j].normals[0].z += tempPoint.z;
-    }
-
-    normalizeVertexNormals();
-}
-
-/*!
- * \brief Compute normal for face defined by 3 points in 3D space.
- *
- * This method is used on each face of the wormhole. Each partial normal is then
- * added to point in face. By this process vertex normals are calculated.
- *
- * \return Computed face normal defined in 3D space.
- */
-sPoint3 cWormhole::computeFaceNormal(sPoint3 point0, sPoint3 point1,
-                                     sPoint3 point2)
-{
-    sPoint3 retPoint;
-
-    float dx1 = point1.x - point0.x;
-    float dy1 = point1.y - point0.y;
-    float dz1 = point1.z - point0.z;
-    float dx2 = point2.x - point0.x;
-    float dy2 = point2.y - point0.y;
-    float dz2 = point2.z - point0.z;
-    retPoint.x = dy1*dz2 - dz1*dy2;
-    retPoint.y = dz1*dx2 - dx1*dz2;
-    retPoint.z = dx1*dy2 - dy1*dx2;
-    float d = sqrt(retPoint.x*retPoint.x + retPoint.y*retPoint.y + \
-                   retPoint.z*retPoint.z);
-    if (d == 0.0)
-    {
-      retPoint.x = 1;
-      retPoint.y = 0;
-      retPoint.z = 0;
-    }
+    first = qMax(first, 0);
+    last = qMin(last, whSectors);
+    if (first >= last)
+        return;
+
+    int stride = circleSectors + 1;
+    float * rowPrev = faceNormals;
+    float * rowNext = faceNormals + 3*stride;
+    float * rowSum = faceNormals + 6*stride;
+
+    // faces before the first circle, the entrance has none
+    if (first > 0)
+        faceNormalRow(store.circle(first-1), store.circle(first),
+                      circleSectors,
+                      rowPrev, rowPrev + stride, rowPrev + 2*stride);
     else
+        memset(rowPrev, 0, 3*stride*sizeof(float));
+
+    for (int j=first; j<last; j++)
     {
-      retPoint.x /= d;
-      retPoint.y /= d;
-      retPoint.z /= d;
+        // faces after circle j, the exit has none
+        if (j+1 < whSectors)
+            faceNormalRow(store.circle(j), store.circle(j+1), circleSectors,
+                          rowNext, rowNext + stride, rowNext + 2*stride);
+        else
+            memset(rowNext, 0, 3*stride*sizeof(float));
+
+        vertexNormalRow(rowPrev, rowNext, rowSum, circleSectors, stride,
+                        store.normals(j));
+        qSwap(rowPrev, rowNext);
     }
-    return retPoint;
 }
 
 /*!
- * \brief Normalize vertex normals.
+ * \brief Builds unit ring of circleSectors points.
  *
- * Normalize vertex normals of wormhole. Bad normals may result in glitches on
- * rendered objects. OpenGL can handel normalizing of normals on it's own, but
- * who knows. It's basicly a good habbit to normalize these little dummies.
+ * Circles of all sectors share the same angles, so their cosines and sines
+ * are calculated only when the number of circle sectors changes. Scratch
+ * rows for cWormhole::genNormals() are allocated along with them.
  */
-void cWormhole::normalizeVertexNormals()
+void cWormhole::buildUnitRing()
 {
-    float d;
+    const double Pi = 3.14159265358979323846;
+    int stride = circleSectors + 1;
 
-    for (int j=0; j<whSectors; j++)
+    freeUnitRing();
+    unitCos = new float[2*circleSectors];
+    unitSin = unitCos + circleSectors;
+    faceNormals = new float[9*stride];
+    ringSectors = circleSectors;
+
+    for (int j=0; j<circleSectors; j++)
     {
-        for(int i=0; i<circleSectors; i++)
-        {
-            d = sqrt(sectors[j].normals[i].x*sectors[j].normals[i].x +
-                     sectors[j].normals[i].y*sectors[j].normals[i].y +
-                     sectors[j].normals[i].z*sectors[j].normals[i].z);
-            if (d == 0.0)
-            {
-                sectors[j].normals[i].x = 1;
-                sectors[j].normals[i].y = 0;
-                sectors[j].normals[i].z = 0;
-            }
-            else
-            {
-                sectors[j].normals[i].x = sectors[j].normals[i].x / d;
-                sectors[j].normals[i].y = sectors[j].normals[i].y / d;
-                sectors[j].normals[i].z = sectors[j].normals[i].z / d;
-            }
-        }
+        double angle = (j * 2 * Pi) / circleSectors;
+        unitCos[j] = cos(angle);
+        unitSin[j] = sin(angle);
     }
 }
 
 /*!
- * \brief Calculate spline points for control points.
+ * \brief Frees unit ring.
+ */
+void cWormhole::freeUnitRing()
+{
+    delete [] unitCos;
+    delete [] faceNormals;
+    unitCos = NULL;
+    unitSin = NULL;
+    faceNormals = NULL;
+    ringSectors = 0;
+}
+
+/*!
+ * \brief Calculate spline points and radius of sectors.
  *
  * n > the number of control points minus 1.
  * t > the degree of the polynomial plus 1.
- * listPoints > control point array made up of point stucture
- * sectors > array of sStruct where calculated spline points will be stored
- * num_output > number of points on the spline
+ * first, last > sectors <first, last) will be calculated
  *
- * \sa cWormhole::bsplineSectorRadius()
+ * Blending weights of sectors do not change between regenerations, only
+ * control points do. So every sector is just a weighted sum of t control
+ * points taken from the weight table (see cWormhole::buildWeightTable()).
+ * Spline point (from listControlPoints) and radius (from
+ * listControlRadiusPoints) of a sector share the same weights.
  */
-void cWormhole::bsplineSectorPoints(int n, int t,
-                                    QList<sPoint3> listPoints,
-                                    sSector *sectors, int num_sectors)
+void cWormhole::bsplineSectors(sSectorStore &store, int n, int t, int first,
+                               int last)
 {
-  int *u;
-  double increment,interval;
-  sPoint3 calcxyz;
-  int output_index;
-
-  u = new int[n+t+1];
-  compute_intervals(u, n, t);
+  for(int output_index=first; output_index<last; output_index++)
+  {
+    const double *w = weights + output_index*t;
+    int k0 = weightFirst[output_index];
 
-  increment = (double) (n-t+2)/(num_sectors-1);  // how much parameter goes up each time
-  interval = 0;
+    double x = 0, y = 0, z = 0, r = 0;
+    for (int k=0; k<t; k++)
+    {
+      const sPoint3 &point = store.listControlPoints.at(k0+k);
+      x += point.x * w[k];
+      y += point.y * w[k];
+      z += point.z * w[k];
+      r += store.listControlRadiusPoints.at(k0+k).y * w[k];
+    }
 
-  for(output_index=0; output_index<num_sectors-1; output_index++)
-  {
-    compute_point(u, n, t, interval, listPoints, &calcxyz);
-    sectors[output_index].splinePoint.x = calcxyz.x;
-    sectors[output_index].splinePoint.y = calcxyz.y;
-    sectors[output_index].splinePoint.z = calcxyz.z;
-    interval=interval+increment;  // increment our parameter
+    sPoint3 &point = store.splinePoint(output_index);
+    point.x = x;
+    point.y = y;
+    point.z = z;
+    store.radius(output_index) = r;
   }
-  // last point
-  sectors[num_sectors-1].splinePoint.x = listPoints.at(n).x;
-  sectors[num_sectors-1].splinePoint.y = listPoints.at(n).y;
-  sectors[num_sectors-1].splinePoint.z = listPoints.at(n).z;
-
-  delete u;
 }
 
 /*!
- * \brief Calculate spline points for control points.
- *
- * n >> the number of control points minus 1.
- * t >> the degree of the polynomial plus 1.
- * listPoints >> list of control points (sPoint3)
- * sectors >> array of sStruct where calculated spline points will be stored
- * num_output >> number of points on the spline
+ * \brief Builds table of blending weights for every sector.
  *
- * \sa cWormhole::bsplineSectorPoints()
+ * Knot vector and parameters of sectors depend only on nControlPoints, t and
+ * whSectors. So the non-zero basis functions of each sector are calculated
+ * once here and reused by every cWormhole::bsplineSectors() call until the
+ * number of sectors changes.
  */
-void cWormhole::bsplineSectorRadius(int n, int t,
-                                    QList<sPoint3> listPoints,
-                                    sSector *sectors, int num_sectors)
+void cWormhole::buildWeightTable()
 {
-  int *u;
-  double increment,interval;
-  sPoint3 calcxyz;
-  int output_index;
-
-  u = new int[n+t+1];
+  int n = nControlPoints;
+  int *u = new int[n+t+1];
   compute_intervals(u, n, t);
 
-  increment = (double) (n-t+2)/(num_sectors-1);  // how much parameter goes up each time
-  interval = 0;
+  freeWeightTable();
+  weightFirst = new int[whSectors];
+  weights = new double[whSectors*t];
+  weightSectors = whSectors;
 
-  for(output_index=0; output_index<num_sectors-1; output_index++)
+  for (int i=0; i<whSectors; i++)
   {
-    compute_point(u, n, t, interval, listPoints, &calcxyz);
-    sectors[output_index].radius = calcxyz.y;
-    interval=interval+increment;  // increment our parameter
+    double interval = (double) i / sectorsPerSpan;
+    int span = find_span(u, n, t, interval);
+    weightFirst[i] = span-t+1;
+    compute_basis(u, span, t, interval, weights + i*t);
   }
-  // last point
-  sectors[num_sectors-1].radius = listPoints.at(n).y;
 
   delete [] u;
 }
 
-double cWormhole::blend(int k, int t, int *u, double v)  // calculate the blending value
+/*!
+ * \brief Frees table of blending weights.
+ */
+void cWormhole::freeWeightTable()
 {
-  double value;
-
-  if (t==1)			// base case for the recursion
-  {
-    if ((u[k]<=v) && (v<u[k+1]))
-      value=1;
-    else
-      value=0;
-  }
-  else
-  {
-    if ((u[k+t-1]==u[k]) && (u[k+t]==u[k+1]))  // check for divide by zero
-      value = 0;
-    else
-    if (u[k+t-1]==u[k]) // if a term's denominator is zero,use just the other
-      value = (u[k+t] - v) / (u[k+t] - u[k+1]) * blend(k+1, t-1, u, v);
-    else
-    if (u[k+t]==u[k+1])
-      value = (v - u[k]) / (u[k+t-1] - u[k]) * blend(k, t-1, u, v);
-    else
-      value = (v - u[k]) / (u[k+t-1] - u[k]) * blend(k, t-1, u, v) +
-          (u[k+t] - v) / (u[k+t] - u[k+1]) * blend(k+1, t-1, u, v);
-  }
-  return value;
+  delete [] weightFirst;
+  delete [] weights;
+  weightFirst = NULL;
+  weights = NULL;
+  weightSectors = 0;
 }
 
 void cWormhole::compute_intervals(int *u, int n, int t)   // figure out the knots
@@ -583,22 +1497,58 @@ void cWormhole::compute_intervals(int *u, int n, int t)   // figure out the knot
   }
 }
 
-void cWormhole::compute_point(int *u, int n, int t, double v,
-                              QList<sPoint3> listPoints, sPoint3 *output)
+/*!
+ * \brief Find knot span of parameter v.
+ *
+ * \return Index j of the knot span u[j] <= v < u[j+1]. End of the parameter
+ * range belongs to the last span.
+ */
+int cWormhole::find_span(int *u, int n, int t, double v)
 {
-  int k;
-  double temp;
+  if (v >= u[n+1])
+    return n;
+  if (v <= u[t-1])
+    return t-1;
+
+  int low = t-1;
+  int high = n+1;
+  while (high - low > 1)  // binary search, u[low] <= v < u[high]
+  {
+    int mid = (low + high) / 2;
+    if (v < u[mid])
+      high = mid;
+    else
+      low = mid;
+  }
+  return low;
+}
 
-  // initialize the variable that will hold outputted point
-  output->x=0;
-  output->y=0;
-  output->z=0;
+/*!
+ * \brief Calculate basis functions which are non-zero in knot span.
+ *
+ * Only t basis functions (of control points span-t+1 ... span) are non-zero
+ * in a knot span. They are built up iteratively from degree 0, the same way
+ * as in de Boor's algorithm, so no recursion is needed.
+ */
+void cWormhole::compute_basis(int *u, int span, int t, double v,
+                              double *basis)
+{
+  double left[16];  // t-1 (degree of polynomial) is never that high
+  double right[16];
+  double saved, temp;
 
-  for (k=0; k<=n; k++)
+  basis[0] = 1.0;
+  for (int j=1; j<t; j++)
   {
-    temp = blend(k,t,u,v);  // same blend is used for each dimension coordinate
-    output->x = output->x + listPoints.at(k).x * temp;
-    output->y = output->y + listPoints.at(k).y * temp;
-    output->z = output->z + listPoints.at(k).z * temp;
+    left[j] = v - u[span+1-j];
+    right[j] = u[span+j] - v;
+    saved = 0.0;
+    for (int r=0; r<j; r++)
+    {
+      temp = basis[r] / (right[r+1] + left[j-r]);
+      basis[r] = saved + right[r+1] * temp;
+      saved = left[j-r] * temp;
+    }
+    basis[j] = saved;
   }
 }
@@ -12,13 +12,90 @@
 
 
 #include "cglobject.h"
+#include "csectortree.h"
 #include "myinclude.h"
 
-struct sSector {
-    sPoint3 * circle;
-    sPoint3 * normals;
-    sPoint3 splinePoint;
-    float radius;
+#include <QFuture>
+#include <QGLBuffer>
+#include <QVector>
+
+// range of number of sectors, whSectors is rounded into it
+static const int minWhSectors = 20;
+static const int maxWhSectors = 400;
+
+/*!
+ * \brief Generated sectors of the wormhole and control points they come from.
+ *
+ * Sectors are stored in a ring, sector 0 is the wormhole entrance. Vertices,
+ * normals, spline points and radius of all sectors live in one block of
+ * memory, vertex i of ring slot s is at index s*circleSectors+i.
+ */
+struct sSectorStore {
+    inline int slot(int i) const
+    {
+        return (firstSector + i) % whSectors;
+    }
+    inline sPoint3 * circle(int i)
+    {
+        return circleData + slot(i)*circleSectors;
+    }
+    inline sPoint3 * normals(int i)
+    {
+        return normalData + slot(i)*circleSectors;
+    }
+    inline sPoint3 & splinePoint(int i)
+    {
+        return splineData[slot(i)];
+    }
+    inline float & radius(int i)
+    {
+        return radiusData[slot(i)];
+    }
+    inline void markAllDirty()
+    {
+        dirtyHead = whSectors;
+        dirtyTail = 0;
+    }
+    inline void markAllChanged()
+    {
+        changedHead = whSectors;
+        changedTail = 0;
+    }
+
+    int whSectors;
+    int circleSectors;
+    int firstSector;    // index of wormhole entrance in sectors ring
+    int firstSerial;    // serial number of the entrance, texture coordinate
+    int shiftedSectors; // sectors shifted out since the wormhole was made,
+                        // unlike firstSerial never rebased
+    int firstSpan;      // control points shifted out since they were
+                        // initialized, see cWormhole::splineDistance()
+
+    // sectors <0, dirtyHead) and <dirtyTail, whSectors) are not uploaded to
+    // vertex buffer yet, dirtyHead >= dirtyTail means all of them
+    int dirtyHead;
+    int dirtyTail;
+
+    // sectors <0, changedHead) and <changedTail, whSectors) are the only ones
+    // differing from the store this one was shifted from (the other store),
+    // changedHead >= changedTail means all of them
+    int changedHead;
+    int changedTail;
+
+    // one block of memory holding all the streams below
+    sPoint3 * sectorData;
+    int sectorCapacity;
+    int vertexCapacity;
+
+    sPoint3 * circleData;  // circleSectors vertices of each sector
+    sPoint3 * normalData;  // circleSectors normals of each sector
+    sPoint3 * splineData;  // spline point of each sector
+    float * radiusData;    // radius of each sector
+
+    QList<sPoint3> listControlPoints;
+    QList<sPoint3> listControlRadiusPoints;
+
+    cSectorTree tree;      // bounding volumes of sectors
 };
 
 /*!
@@ -29,6 +106,10 @@ struct sSector {
  * cMainWindow object GUI. Some times (like in restart after collision) wormhole
  * needs to be recreated. For these cases, using updateObject() method is
  * adviced.
+ *
+ * Wormhole goes along x axis, unless bWinding is set. Winding wormhole turns
+ * in all directions and may come back, sectors are then found by their
+ * cSectorTree rather than by x.
  */
 class cWormhole : public cGLObject
 {
@@ -39,34 +120,107 @@ public:
                     QLabel * progress_label = NULL);
     void initializeWormholeCoordinates();
     void updateObject(int newWhSectors, int newCircleSectors);
-    GLuint makeDisplayList(int polygons = 0);
+    void shiftObject(int nShift);
+    void makeBuffers();
+    void draw(int polygons = 0);
+    bool touchesWall(int j, const float * x, const float * y,
+                     const float * z, int n);
+    float planeDistance(int i, const sPoint3 &p);
+    float sectorParam(int j, const sPoint3 &p);
+    float splineDistance(int i);
+    int nearestSector(const sPoint3 &p);
+    void sectorsNear(const sPoint3 &min, const sPoint3 &max,
+                     QVector<int> &sectors);
 
-    sSector * sectors;
-    QList<sPoint3> listControlPoints;
-    QList<sPoint3> listControlRadiusPoints;
+    void startShift(int nShift);
+    bool finishShift();
+    void waitForShift();
+    inline bool isShifting() const
+    {
+        return shifting;
+    }
+
+    // sectors of the front store, sector 0 is the wormhole entrance
+    inline sPoint3 * circle(int i)
+    {
+        return front->circle(i);
+    }
+    inline sPoint3 * normals(int i)
+    {
+        return front->normals(i);
+    }
+    inline sPoint3 & splinePoint(int i)
+    {
+        return front->splinePoint(i);
+    }
+    inline float & radius(int i)
+    {
+        return front->radius(i);
+    }
+
+    // front store is drawn, the back one is generated in background
+    sSectorStore stores[2];
+    sSectorStore * front;
+    sSectorStore * back;
+    QFuture<void> shiftFuture;
+    bool shifting;
+    int generation; // counts resets of shiftedSectors, see cSectorCursor
 
     int nControlPoints;
     int whSectors;
     int circleSectors;
     int t;           // degree of polynomial = t-1
 
+    int sectorsPerSpan; // sectors generated for one knot span of spline
+    bool bWinding;      // control points turn in all directions
+
+    // sparse sector x control point weights, t weights per sector
+    int * weightFirst;  // first control point with non-zero weight
+    double * weights;
+    int weightSectors;  // number of sectors the table was built for
+
+    // vertex buffer of the front store, index buffer holds triangles followed
+    // by quads and is built only when the number of sectors changes
+    QGLBuffer vertexBuffer;
+    QGLBuffer indexBuffer;
+    QVector<sVertex> vertices; // vertexBuffer data before upload
+    QVector<sPackedVertex> packedVertices; // the same, if bPackedVertices
+    int nTriangleIndices;
+    int nQuadIndices;
+    int indexWhSectors;        // whSectors the index buffer was built for
+    int indexCircleSectors;    // circleSectors the index buffer was built for
+
+    float * unitCos;     // cos of circle sector angles, circleSectors values
+    float * unitSin;     // sin of circle sector angles, circleSectors values
+    float * faceNormals; // face normal rows used by genNormals()
+    int ringSectors;     // number of circle sectors the ring was built for
+
 private:
+    void allocSectors(int newWhSectors, int newCircleSectors);
+    void allocStore(sSectorStore &store);
+    void freeStore(sSectorStore &store);
+    void appendControlPoint(sSectorStore &store);
+    void shiftSectors(int nShift);
+    void copySectors(sSectorStore &store, int first, int last);
+    void generateSectors(sSectorStore &store, int first, int last);
+    void buildWeightTable();
+    void freeWeightTable();
+    void buildUnitRing();
+    void freeUnitRing();
+    void buildIndices();
+    bool packingCovers(int first, int last);
+    void choosePacking();
+    void uploadSectors(int first, int last);
     void compute_intervals(int *u, int n, int t);
-    double blend(int k, int t, int *u, double v);
-    void compute_point(int *u, int n, int t, double v,
-                       QList<sPoint3> listPoints,
-                       sPoint3 *output);
-    void bsplineSectorPoints(int n, int t, QList<sPoint3> listPoints,
-                             sSector *sectors, int whSectors);
-    void bsplineSectorRadius(int n, int t, QList<sPoint3> listPoints,
-                             sSector *sectors, int whSectors);
-    sPoint3 computeFaceNormal(sPoint3 point0, sPoint3 point1, sPoint3 point2);
-    void normalizeVertexNormals();
-    void genPoints();
-    void genCircles(sSector *sectors);
-    void genNormals(sSector *sectors);
-
+    int find_span(int *u, int n, int t, double v);
+    void compute_basis(int *u, int span, int t, double v, double *basis);
+    void bsplineSectors(sSectorStore &store, int n, int t, int first,
+                        int last);
+    void genCircles(sSectorStore &store, int first, int last);
+    void genNormals(sSectorStore &store, int first, int last);
+    void tangent(int i, float * n);
 
+    friend class cWormholeBench; // bench/wormholebench.cpp times generators
 };
 
 
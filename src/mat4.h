@@ -0,0 +1,144 @@
+#include "math.h"
+#include "vec3.h"
+#include "quat.h"
+
+#ifndef MAT4_H
+#define MAT4_H
+
+/*!
+ * \class mat4
+ * \brief Auxiliary class for transformation matrices.
+ *
+ * Matrices are computed here instead of on OpenGL matrix stack, so they never
+ * have to be read back by glGetDoublev(). Elements are stored by columns, as
+ * glLoadMatrixd() expects them. Rotations and translations multiply from the
+ * right, the same way glRotatef() and glTranslatef() do. No source file is
+ * needed since all methods are implemented within this scope.
+ */
+class mat4
+{
+public:
+    // Data
+    double m[16];
+
+    // Creators
+    mat4( )
+    {
+        for ( int i = 0; i < 16; i++ )
+            m[i] = ( i % 5 == 0 ) ? 1.0 : 0.0;
+    }
+    // rotation by Q followed by translation to T
+    mat4( const quat &Q, const vec3 &T )
+    {
+        float xx = Q.x*Q.x, yy = Q.y*Q.y, zz = Q.z*Q.z;
+        float xy = Q.x*Q.y, xz = Q.x*Q.z, yz = Q.y*Q.z;
+        float wx = Q.w*Q.x, wy = Q.w*Q.y, wz = Q.w*Q.z;
+
+        m[0] = 1 - 2*(yy + zz);
+        m[1] = 2*(xy + wz);
+        m[2] = 2*(xz - wy);
+        m[3] = 0;
+
+        m[4] = 2*(xy - wz);
+        m[5] = 1 - 2*(xx + zz);
+        m[6] = 2*(yz + wx);
+        m[7] = 0;
+
+        m[8]  = 2*(xz + wy);
+        m[9]  = 2*(yz - wx);
+        m[10] = 1 - 2*(xx + yy);
+        m[11] = 0;
+
+        m[12] = T.x;
+        m[13] = T.y;
+        m[14] = T.z;
+        m[15] = 1;
+    }
+
+    static mat4 Translation( float X, float Y, float Z )
+    {
+        return mat4(quat(), vec3(X, Y, Z));
+    }
+    // same as glRotatef()
+    static mat4 Rotation( float Angle, float X, float Y, float Z )
+    {
+        return mat4(quat(Angle, vec3(X, Y, Z)), vec3());
+    }
+    // same as gluLookAt()
+    static mat4 LookAt( const vec3 &Eye, const vec3 &Center, const vec3 &Up )
+    {
+        vec3 f = Center - Eye;
+        f.Normalize();
+        vec3 s = f.CrossProduct(Up);
+        s.Normalize();
+        vec3 u = s.CrossProduct(f);
+
+        mat4 M;
+        M.m[0] = s.x;   M.m[4] = s.y;   M.m[8]  = s.z;
+        M.m[1] = u.x;   M.m[5] = u.y;   M.m[9]  = u.z;
+        M.m[2] = -f.x;  M.m[6] = -f.y;  M.m[10] = -f.z;
+        M.m[12] = -s.Dot(Eye);
+        M.m[13] = -u.Dot(Eye);
+        M.m[14] = f.Dot(Eye);
+        return M;
+    }
+
+    // Operator Overloads
+    inline mat4 operator* (const mat4& M2) const
+    {
+        mat4 M;
+        for ( int c = 0; c < 4; c++ )
+            for ( int r = 0; r < 4; r++ )
+                M.m[c*4 + r] = m[r]    * M2.m[c*4]     +
+                               m[4+r]  * M2.m[c*4 + 1] +
+                               m[8+r]  * M2.m[c*4 + 2] +
+                               m[12+r] * M2.m[c*4 + 3];
+        return M;
+    }
+
+    inline void operator*= ( const mat4& M2 )
+    {
+        *this = *this * M2;
+    }
+
+    inline double & operator[] ( int i )
+    {
+        return m[i];
+    }
+    inline double operator[] ( int i ) const
+    {
+        return m[i];
+    }
+
+    // Functions
+    inline vec3 TransformPoint( const vec3 &V ) const
+    {
+        return vec3(
+            m[0]*V.x + m[4]*V.y + m[8]*V.z  + m[12],
+            m[1]*V.x + m[5]*V.y + m[9]*V.z  + m[13],
+            m[2]*V.x + m[6]*V.y + m[10]*V.z + m[14] );
+    }
+
+    // rotation only, translation does not apply to directions
+    inline vec3 TransformVector( const vec3 &V ) const
+    {
+        return vec3(
+            m[0]*V.x + m[4]*V.y + m[8]*V.z,
+            m[1]*V.x + m[5]*V.y + m[9]*V.z,
+            m[2]*V.x + m[6]*V.y + m[10]*V.z );
+    }
+
+    inline vec3 Position( ) const
+    {
+        return vec3(m[12], m[13], m[14]);
+    }
+
+    // for glLoadMatrixd() and glMultMatrixd()
+    inline const double * Data( ) const
+    {
+        return m;
+    }
+};
+
+
+#endif // MAT4_H
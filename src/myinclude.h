@@ -8,5 +8,51 @@ struct sPoint3 {
     float z;
 };
 
+// interleaved vertex (position, normal, texture coordinates) of vertex buffers
+struct sVertex {
+    float x, y, z;
+    float nx, ny, nz;
+    float s, t;
+};
+
+// compact vertex of vertex buffers, 14 bytes instead of 32 of sVertex; GL
+// arrays need 3 normal components, nw only keeps s and t aligned
+struct sPackedVertex {
+    short x, y, z;             // position, see sVertexPacking
+    signed char nx, ny, nz, nw; // unit normal times 127
+    short s, t;                // texture coordinates, see sVertexPacking
+};
+
+// position of sPackedVertex is offset + scale*(x, y, z), its texture
+// coordinates are texOffset + texScale*(s, t)
+struct sVertexPacking {
+    float offset[3];
+    float scale;
+    float texOffset[2];
+    float texScale;
+};
+
+// rounds v to the nearest short, values out of range are clamped
+inline short packShort(float v)
+{
+    if(v >= 32767.0f) return 32767;
+    if(v <= -32767.0f) return -32767;
+    return (short) (v < 0.0f ? v - 0.5f : v + 0.5f);
+}
+
+inline void packVertex(const sVertex &v, const sVertexPacking &packing,
+                       sPackedVertex &p)
+{
+    p.x = packShort((v.x - packing.offset[0]) / packing.scale);
+    p.y = packShort((v.y - packing.offset[1]) / packing.scale);
+    p.z = packShort((v.z - packing.offset[2]) / packing.scale);
+    p.nx = (signed char) (packShort(v.nx*127.0f));
+    p.ny = (signed char) (packShort(v.ny*127.0f));
+    p.nz = (signed char) (packShort(v.nz*127.0f));
+    p.nw = 0;
+    p.s = packShort((v.s - packing.texOffset[0]) / packing.texScale);
+    p.t = packShort((v.t - packing.texOffset[1]) / packing.texScale);
+}
+
 
 #endif // MYINCLUDE_H
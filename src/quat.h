@@ -0,0 +1,88 @@
+#include "math.h"
+#include "vec3.h"
+
+#ifndef QUAT_H
+#define QUAT_H
+
+/*!
+ * \class quat
+ * \brief Auxiliary class for rotations.
+ *
+ * Unit quaternion holds orientation of the space ship. Unlike a matrix
+ * multiplied by a rotation every frame, it is easily kept normalized. No
+ * source file is needed since all methods are implemented within this scope.
+ */
+class quat
+{
+public:
+    // Data
+    float w, x, y, z;
+
+    // Creators
+    quat( float InW, float InX, float InY, float InZ ) :
+        w( InW ), x( InX ), y( InY ), z( InZ )
+    {
+    }
+    quat( ) : w(1), x(0), y(0), z(0)
+    {
+    }
+    // rotation by Angle degrees around Axis, as glRotatef() does
+    quat( float Angle, const vec3 &Axis )
+    {
+        vec3 a = Axis;
+        a.Normalize();
+        float half = Angle * 0.5f * 0.01745329252f;
+        float s = sinf( half );
+        w = cosf( half );
+        x = a.x * s;
+        y = a.y * s;
+        z = a.z * s;
+    }
+
+    // Operator Overloads
+    // rotation by Q2 first, then by this one
+    inline quat operator* (const quat& Q2) const
+    {
+        return quat(
+            w * Q2.w  -  x * Q2.x  -  y * Q2.y  -  z * Q2.z,
+            w * Q2.x  +  x * Q2.w  +  y * Q2.z  -  z * Q2.y,
+            w * Q2.y  -  x * Q2.z  +  y * Q2.w  +  z * Q2.x,
+            w * Q2.z  +  x * Q2.y  -  y * Q2.x  +  z * Q2.w );
+    }
+
+    inline void operator*= ( const quat& Q2 )
+    {
+        *this = *this * Q2;
+    }
+
+    // Functions
+    inline quat Conjugate( ) const
+    {
+        return quat(w, -x, -y, -z);
+    }
+
+    inline vec3 Rotate( const vec3 &V ) const
+    {
+        // v' = v + 2*q x (q x v + w*v), q being the vector part
+        vec3 q(x, y, z);
+        vec3 t = q.CrossProduct(V) * 2.0f;
+        return V + t * w + q.CrossProduct(t);
+    }
+
+    // These require math.h for the sqrtf function
+    inline void Normalize()
+    {
+        float fMag = ( w*w + x*x + y*y + z*z );
+        if (fMag == 0) {return;}
+
+        float fMult = 1.0f/sqrtf(fMag);
+        w *= fMult;
+        x *= fMult;
+        y *= fMult;
+        z *= fMult;
+        return;
+    }
+};
+
+
+#endif // QUAT_H
@@ -0,0 +1,17 @@
+# -------------------------------------------------
+# Tests of mat4 and quat, obj parsing and the mesh cache. Build with
+# qmake tests.pro && make, wormholetests returns the number of failures.
+# -------------------------------------------------
+QT += opengl
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = wormholetests
+INCLUDEPATH += ..
+SOURCES += wormholetests.cpp \
+    ../cobj2ogl.cpp
+HEADERS += ../cobj2ogl.h \
+    ../myinclude.h \
+    ../vec3.h \
+    ../quat.h \
+    ../mat4.h
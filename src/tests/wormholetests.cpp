@@ -0,0 +1,355 @@
+/*!
+ * \file wormholetests.cpp
+ *
+ * \author David Smejkal
+ * \date 17.10.2026
+ *
+ * Tests of mat4 and quat, obj parsing (negative indices among others) and
+ * the mesh cache of cObj2OGL. Every failed check is printed, the number of
+ * failures is returned.
+ */
+
+#include <QDir>
+#include <QFile>
+#include <QByteArray>
+#include <QVector>
+
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+
+#include "cobj2ogl.h"
+#include "mat4.h"
+
+static const double Pi = 3.14159265358979323846;
+// tolerance of float comparisons
+static const float testEpsilon = 1e-5f;
+// triangles of the obj file parsed in chunks, its negative indices cross
+// chunk boundaries, see objChunkMin of cobj2ogl.cpp
+static const int chunkedTriangles = 40000;
+// rings and segments of the sphere of the mesh cache tests
+static const int sphereRings = 24;
+static const int sphereSegments = 48;
+
+static int failures = 0;
+
+/*!
+ * \brief Prints and counts a failed check.
+ */
+static void check(bool bPassed, const char *what)
+{
+    if(bPassed) return;
+
+    printf("FAIL: %s\n", what);
+    failures++;
+}
+
+static bool equal(double a, double b)
+{
+    return fabs(a - b) <= testEpsilon;
+}
+
+static bool equal(const vec3 &a, const vec3 &b)
+{
+    return equal(a.x, b.x) && equal(a.y, b.y) && equal(a.z, b.z);
+}
+
+static bool equal(const mat4 &a, const mat4 &b)
+{
+    for(int i = 0; i < 16; i++)
+        if(!equal(a[i], b[i])) return false;
+    return true;
+}
+
+/*!
+ * \brief Rotation matrix by the formula of glRotatef() documentation.
+ */
+static mat4 glRotation(float angle, float x, float y, float z)
+{
+    float len = sqrt(x*x + y*y + z*z);
+    x /= len;
+    y /= len;
+    z /= len;
+    float c = cos(angle*Pi/180.0);
+    float s = sin(angle*Pi/180.0);
+    float d = 1 - c;
+
+    mat4 M;
+    M[0] = x*x*d + c;   M[4] = x*y*d - z*s; M[8]  = x*z*d + y*s;
+    M[1] = y*x*d + z*s; M[5] = y*y*d + c;   M[9]  = y*z*d - x*s;
+    M[2] = x*z*d - y*s; M[6] = y*z*d + x*s; M[10] = z*z*d + c;
+    return M;
+}
+
+/*!
+ * \brief mat4 and quat compose the same way as glRotatef(), glTranslatef().
+ */
+static void testMatrices()
+{
+    vec3 p(0.3, -1.2, 2.5);
+
+    check(equal(mat4::Rotation(90, 0, 0, 1).TransformPoint(vec3(1, 0, 0)),
+               vec3(0, 1, 0)),
+          "mat4::Rotation() turns counterclockwise");
+    check(equal(mat4::Rotation(37, 1, -2, 0.5), glRotation(37, 1, -2, 0.5)),
+          "mat4::Rotation() matches glRotatef()");
+
+    mat4 T = mat4::Translation(1, 2, 3);
+    mat4 R = mat4::Rotation(-115, 0.2, 1, 0.7);
+    check(equal((T*R).TransformPoint(p), R.TransformPoint(p) + vec3(1, 2, 3)),
+          "translation multiplied from the right applies last");
+    check(equal((T*R).TransformVector(p), R.TransformVector(p)),
+          "mat4::TransformVector() ignores translation");
+    check(equal((T*R).Position(), vec3(1, 2, 3)),
+          "mat4::Position() is the translation");
+
+    mat4 M = T;
+    M *= R;
+    check(equal(M, T*R), "mat4::operator*=() multiplies from the right");
+
+    quat q1(40, vec3(0, 1, 0));
+    quat q2(-75, vec3(1, 0.5, -0.3));
+    check(equal((q1*q2).Rotate(p), q1.Rotate(q2.Rotate(p))),
+          "quat product rotates by the right one first");
+    check(equal(mat4(q1*q2, vec3()), mat4(q1, vec3())*mat4(q2, vec3())),
+          "matrix of quat product is product of matrices");
+    check(equal(q1.Conjugate().Rotate(q1.Rotate(p)), p),
+          "quat::Conjugate() rotates back");
+
+    quat q(2*q2.w, 2*q2.x, 2*q2.y, 2*q2.z);
+    q.Normalize();
+    check(equal(q.Rotate(p), q2.Rotate(p)), "quat::Normalize() keeps rotation");
+
+    mat4 V = mat4::LookAt(vec3(0, 0, 5), vec3(0, 0, 0), vec3(0, 1, 0));
+    check(equal(V.TransformPoint(vec3(0, 0, 0)), vec3(0, 0, -5)),
+          "mat4::LookAt() puts center in front of the eye like gluLookAt()");
+    check(equal(V.TransformPoint(vec3(0, 1, 5)), vec3(0, 1, 0)),
+          "mat4::LookAt() keeps up vector up");
+}
+
+static QString tempPath(const char *name)
+{
+    return QDir::temp().filePath(QString("wormholetests_") + name);
+}
+
+static bool writeFile(QString path, const QByteArray &data)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    return file.write(data) == data.size();
+}
+
+/*!
+ * \brief Removes obj file and its mesh cache.
+ */
+static void removeObj(QString path)
+{
+    QFile::remove(path);
+    QFile::remove(path + QString(".cache"));
+}
+
+/*!
+ * \brief Parses obj file, without building the mesh.
+ */
+static bool parse(QString path, cObj2OGL &obj)
+{
+    QFile::remove(path + QString(".cache"));
+    return obj.makeObjectFromObjFileWithNormals(path, NULL, NULL) == 1;
+}
+
+static bool sameCorners(const cObj2OGL &a, const cObj2OGL &b)
+{
+    if(a.faceCorners.size() != b.faceCorners.size() ||
+       a.faceOffsets != b.faceOffsets)
+        return false;
+    for(int i = 0; i < a.faceCorners.size(); i++)
+        if(!(a.faceCorners.at(i) == b.faceCorners.at(i)))
+            return false;
+    return true;
+}
+
+/*!
+ * \brief Obj indices, positive and negative, become the same 0-based ones.
+ */
+static void testObjIndices()
+{
+    QByteArray head("v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+                    "vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+                    "vn 0 0 1\n");
+    QString positivePath = tempPath("positive.obj");
+    QString negativePath = tempPath("negative.obj");
+    writeFile(positivePath, head + "f 1/1/1 2/2/1 3/3/1 4/4/1\n");
+    writeFile(negativePath, head + "f -4/-4/-1 -3/-3/-1 -2/-2/-1 -1/-1/-1\n");
+
+    cObj2OGL positive, negative;
+    check(parse(positivePath, positive), "obj with positive indices parsed");
+    check(parse(negativePath, negative), "obj with negative indices parsed");
+    check(positive.faceOffsets.size() == 2 &&
+          positive.faceCorners.size() == 4 &&
+          positive.faceCorners.at(0).vertIndex == 0 &&
+          positive.faceCorners.at(3).vertIndex == 3 &&
+          positive.faceCorners.at(3).textIndex == 3 &&
+          positive.faceCorners.at(3).normIndex == 0,
+          "obj indices count from 1");
+    check(sameCorners(positive, negative),
+          "negative obj indices count back from the last element");
+
+    check(positive.buildMesh() && positive.nMeshVertices == 4 &&
+          positive.meshLodOffsets.size() >= 2 &&
+          positive.meshLodOffsets.at(1) == 6,
+          "quad is welded to 4 vertices and 2 triangles");
+    removeObj(positivePath);
+    removeObj(negativePath);
+
+    // a face referring to a missing vertex is skipped whole
+    QString badPath = tempPath("bad.obj");
+    writeFile(badPath, head + "f 1/1/1 2/2/1 3/3/1\nf 1/1/1 3/3/1 9/4/1\n");
+    cObj2OGL bad;
+    check(parse(badPath, bad) && bad.buildMesh() && bad.nMeshVertices == 3 &&
+          bad.meshLodOffsets.at(1) == 3,
+          "face with a missing vertex is skipped");
+    removeObj(badPath);
+
+    // every triangle refers to the three elements just before it, the same
+    // file with positive indices must give the same corners in any chunks
+    QByteArray positiveData, negativeData;
+    for(int i = 0; i < chunkedTriangles; i++)
+    {
+        QByteArray elements;
+        for(int k = 0; k < 3; k++)
+            elements += QString("v %1 %2 0\nvt %3 0\nvn 0 0 1\n")
+                        .arg(i).arg(k).arg(k).toAscii();
+        positiveData += elements;
+        negativeData += elements;
+        int index = 3*i + 1;
+        positiveData += QString("f %1/%1/%1 %2/%2/%2 %3/%3/%3\n")
+                        .arg(index).arg(index + 1).arg(index + 2).toAscii();
+        negativeData += "f -3/-3/-3 -2/-2/-2 -1/-1/-1\n";
+    }
+    writeFile(positivePath, positiveData);
+    writeFile(negativePath, negativeData);
+
+    cObj2OGL positiveChunked, negativeChunked;
+    check(parse(positivePath, positiveChunked) &&
+          parse(negativePath, negativeChunked) &&
+          positiveChunked.faceCorners.size() == 3*chunkedTriangles &&
+          sameCorners(positiveChunked, negativeChunked),
+          "negative obj indices cross chunks of parallel parsing");
+    removeObj(positivePath);
+    removeObj(negativePath);
+}
+
+/*!
+ * \brief Obj file of uv sphere with normals and texture coordinates.
+ */
+static QByteArray sphereObj()
+{
+    QByteArray data;
+    for(int r = 0; r <= sphereRings; r++)
+        for(int s = 0; s <= sphereSegments; s++)
+        {
+            double theta = Pi*r/sphereRings;
+            double phi = 2.0*Pi*s/sphereSegments;
+            double x = sin(theta)*cos(phi);
+            double y = cos(theta);
+            double z = sin(theta)*sin(phi);
+            data += QString("v %1 %2 %3\nvn %1 %2 %3\nvt %4 %5\n")
+                    .arg(x).arg(y).arg(z)
+                    .arg(s/(double) sphereSegments)
+                    .arg(r/(double) sphereRings).toAscii();
+        }
+
+    int row = sphereSegments + 1;
+    for(int r = 0; r < sphereRings; r++)
+        for(int s = 0; s < sphereSegments; s++)
+        {
+            int a = r*row + s + 1;
+            int corners[4] = {a, a + row, a + row + 1, a + 1};
+            data += "f";
+            for(int k = 0; k < 4; k++)
+                data += QString(" %1/%1/%1").arg(corners[k]).toAscii();
+            data += "\n";
+        }
+    return data;
+}
+
+/*!
+ * \brief Built mesh, as it is drawn and stored in the mesh cache.
+ */
+static QByteArray meshBytes(const cObj2OGL &obj)
+{
+    QByteArray bytes;
+    if(obj.meshPackedData != NULL)
+    {
+        bytes.append((const char *) obj.meshPackedData,
+                     obj.nMeshVertices*sizeof(sPackedVertex));
+        bytes.append((const char *) &obj.meshPacking, sizeof(sVertexPacking));
+    } else
+        bytes.append((const char *) obj.meshVertexData,
+                     obj.nMeshVertices*sizeof(sVertex));
+    bytes.append((const char *) obj.meshIndexData,
+                 obj.nMeshIndices*sizeof(GLuint));
+    for(int i = 0; i < obj.meshLodOffsets.size(); i++)
+        bytes.append(QByteArray::number(obj.meshLodOffsets.at(i)));
+    for(int i = 0; i < obj.meshHull.size(); i++)
+        bytes.append((const char *) &obj.meshHull.at(i), sizeof(sPoint3));
+    bytes.append((const char *) &obj.meshMin, sizeof(sPoint3));
+    bytes.append((const char *) &obj.meshMax, sizeof(sPoint3));
+    return bytes;
+}
+
+/*!
+ * \brief Loads obj file the way cMeshCache does, from its cache if valid.
+ */
+static QByteArray load(QString path, bool &bCached)
+{
+    cObj2OGL obj;
+    obj.makeObjectFromObjFileWithNormals(path, NULL, NULL);
+    obj.buildMesh();
+    bCached = obj.bMeshCached;
+    return meshBytes(obj);
+}
+
+/*!
+ * \brief Mesh cache gives back the built mesh, a broken cache is rebuilt.
+ */
+static void testMeshCache()
+{
+    QString path = tempPath("sphere.obj");
+    removeObj(path);
+    writeFile(path, sphereObj());
+
+    bool bCached;
+    QByteArray built = load(path, bCached);
+    check(!bCached && !built.isEmpty(), "mesh is built without cache");
+    check(QFile::exists(path + QString(".cache")), "mesh cache is written");
+
+    QByteArray cached = load(path, bCached);
+    check(bCached, "mesh is loaded from its cache");
+    check(cached == built, "cached mesh equals the built one");
+
+    // index out of range, indices are at the end of the cache
+    QFile cache(path + QString(".cache"));
+    if(cache.open(QIODevice::ReadWrite))
+    {
+        GLuint index = 0xffffff;
+        cache.seek(cache.size() - sizeof(GLuint));
+        cache.write((const char *) &index, sizeof(index));
+        cache.close();
+    }
+    QByteArray rebuilt = load(path, bCached);
+    check(!bCached && rebuilt == built, "broken mesh cache is rebuilt");
+
+    removeObj(path);
+}
+
+int main()
+{
+    testMatrices();
+    testObjIndices();
+    testMeshCache();
+
+    if(failures == 0)
+        printf("all tests passed\n");
+    return failures;
+}